@@ -0,0 +1,29 @@
+#include "deposition.hpp"
+
+using namespace std;
+
+DepositionScheme Deposition::select_scheme(int n_comp) const
+{
+	if (scheme != DepositionScheme::Auto)
+		return scheme;
+
+	int n_threads = max_threads();
+	if (n_threads == 1)
+		return DepositionScheme::Serial;
+
+	/* the first thread deposits into the result itself */
+	size_t size = (size_t)(n_threads - 1)*n_comp*domain.n_nodes*sizeof(double);
+	if (size <= private_grid_limit)
+		return DepositionScheme::PrivateGrids;
+
+	return DepositionScheme::ColoredTiles;
+}
+
+int Deposition::max_threads()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
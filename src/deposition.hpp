@@ -0,0 +1,219 @@
+#ifndef DEPOSITION_HPP
+#define DEPOSITION_HPP
+
+#include <vector>
+#include <cstddef>
+#include <Eigen/Dense>
+#include "domain.hpp"
+#include "particles.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum class DepositionScheme {Auto, Serial, PrivateGrids, ColoredTiles};
+
+/* scatters particle quantities onto the mesh nodes, optionally in parallel
+ *
+ * PrivateGrids: every thread deposits a fixed block of the particles into
+ * its own copy of the grid, the copies are then summed in thread order
+ *
+ * ColoredTiles: the cells are split into rows along x, rows whose j and k
+ * have the same parity do not share any node and are deposited at the same
+ * time, so no grid copies are needed, but the particles have to be grouped
+ * by cell, the four colors are deposited one after another
+ *
+ * Auto picks the private grids as long as the grid copies stay below the
+ * private grid limit and the colored tiles otherwise, either way the result
+ * only depends on the number of threads and not on the thread timing */
+class Deposition {
+	public:
+		using Vector3i = Eigen::Vector3i;
+		using Vector3d = Eigen::Vector3d;
+
+		explicit Deposition(const Domain &domain) : domain{domain} {}
+
+		void set_scheme(DepositionScheme scheme) {this->scheme = scheme;}
+
+		/* [B] memory that may be spent on the thread private grids */
+		void set_private_grid_limit(std::size_t limit) {private_grid_limit = limit;}
+
+		/* scheme used for a grid with n_comp components per node */
+		DepositionScheme select_scheme(int n_comp) const;
+
+		/* deposit N interleaved components per node into f, kernel(p, c, d, val)
+		 * has to return false for particles that are skipped and otherwise set
+		 * the cell c, the offset d inside the cell and the N values val of
+		 * particle p, f is not cleared
+		 *
+		 * the colored tiles need the particles grouped by cell: the particles of
+		 * cell c are order[offsets[c]], ..., order[offsets[c + 1] - 1], order
+		 * may be nullptr if the particles themselves are sorted by cell */
+		template <int N, typename Kernel>
+		void deposit(DepositionScheme scheme, double *f, int n_particles,
+				Kernel &&kernel, const int *order = nullptr,
+				const int *offsets = nullptr);
+
+		/* split the particles into one block per thread and call
+		 * block(t, begin, end, g) for every block, g is the grid the block
+		 * has to deposit into, the grids are summed afterwards like for the
+		 * private grids, with the serial scheme there is a single block and
+		 * g is f, the colored tiles are not supported */
+		template <int N, typename Block>
+		void deposit_blocks(DepositionScheme scheme, double *f, int n_particles,
+				Block &&block);
+
+		/* add the N values val of a particle in cell c at offset d to f */
+		template <int N>
+		void scatter(double *f, const Vector3i &c, const Vector3d &d,
+				const double *val) const;
+
+		static int max_threads();
+
+	private:
+		template <int N, typename Kernel>
+		void deposit_particle(double *f, int p, Kernel &kernel) const;
+
+		template <int N, typename Kernel>
+		void deposit_tiled(double *f, const int *order, const int *offsets,
+				Kernel &kernel) const;
+
+		const Domain &domain;
+
+		DepositionScheme scheme = DepositionScheme::Auto;
+		std::size_t private_grid_limit = 64 << 20;
+
+		std::vector<AlignedVector<double>> grids;	/* thread private grids */
+};
+
+template <int N, typename Kernel>
+void Deposition::deposit(DepositionScheme scheme, double *f, int n_particles,
+		Kernel &&kernel, const int *order, const int *offsets)
+{
+	switch (scheme) {
+		case DepositionScheme::Auto:
+			deposit<N>(select_scheme(N), f, n_particles, kernel, order, offsets);
+			break;
+		case DepositionScheme::Serial:
+			for (int p = 0; p < n_particles; ++p)
+				deposit_particle<N>(f, p, kernel);
+			break;
+		case DepositionScheme::PrivateGrids:
+			deposit_blocks<N>(scheme, f, n_particles,
+					[&](int, int begin, int end, double *g) {
+				for (int p = begin; p < end; ++p)
+					deposit_particle<N>(g, p, kernel);
+			});
+			break;
+		case DepositionScheme::ColoredTiles:
+			deposit_tiled<N>(f, order, offsets, kernel);
+			break;
+	}
+}
+
+template <int N, typename Kernel>
+void Deposition::deposit_particle(double *f, int p, Kernel &kernel) const
+{
+	Vector3i c;
+	Vector3d d;
+	double val[N];
+	if (kernel(p, c, d, val))
+		scatter<N>(f, c, d, val);
+}
+
+template <int N>
+void Deposition::scatter(double *f, const Vector3i &c, const Vector3d &d,
+		const double *val) const
+{
+	int i = c(X), j = c(Y), k = c(Z);
+	double di = d(X), dj = d(Y), dk = d(Z);
+
+	/* the trilinear weights are shared by all components */
+	const double w[8] = {
+		(1 - di)*(1 - dj)*(1 - dk), (    di)*(1 - dj)*(1 - dk),
+		(1 - di)*(    dj)*(1 - dk), (    di)*(    dj)*(1 - dk),
+		(1 - di)*(1 - dj)*(    dk), (    di)*(1 - dj)*(    dk),
+		(1 - di)*(    dj)*(    dk), (    di)*(    dj)*(    dk)};
+
+	double *fu[8] = {
+		f + N*domain.at(i    ,j    ,k    ), f + N*domain.at(i + 1,j    ,k    ),
+		f + N*domain.at(i    ,j + 1,k    ), f + N*domain.at(i + 1,j + 1,k    ),
+		f + N*domain.at(i    ,j    ,k + 1), f + N*domain.at(i + 1,j    ,k + 1),
+		f + N*domain.at(i    ,j + 1,k + 1), f + N*domain.at(i + 1,j + 1,k + 1)};
+
+	for (int corner = 0; corner < 8; ++corner) {
+		for (int m = 0; m < N; ++m)
+			fu[corner][m] += val[m]*w[corner];
+	}
+}
+
+template <int N, typename Block>
+void Deposition::deposit_blocks(DepositionScheme scheme, double *f,
+		int n_particles, Block &&block)
+{
+	if (scheme == DepositionScheme::Serial) {
+		block(0, 0, n_particles, f);
+		return;
+	}
+
+	const int size = N*domain.n_nodes;
+
+	#pragma omp parallel
+	{
+		int t = 0, n_threads = 1;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		n_threads = omp_get_num_threads();
+#endif
+
+		#pragma omp single
+		grids.resize(n_threads - 1);
+
+		/* the first thread deposits directly into f */
+		double *g = f;
+		if (t > 0) {
+			grids[t - 1].assign(size, 0.0);
+			g = grids[t - 1].data();
+		}
+
+		int begin = (long)n_particles*t/n_threads;
+		int end = (long)n_particles*(t + 1)/n_threads;
+		block(t, begin, end, g);
+
+		#pragma omp barrier
+
+		#pragma omp for schedule(static)
+		for (int u = 0; u < size; ++u) {
+			for (int s = 0; s < n_threads - 1; ++s)
+				f[u] += grids[s][u];
+		}
+	}
+}
+
+template <int N, typename Kernel>
+void Deposition::deposit_tiled(double *f, const int *order, const int *offsets,
+		Kernel &kernel) const
+{
+	const int nci = domain.ni - 1;
+	const int ncj = domain.nj - 1;
+	const int nck = domain.nk - 1;
+
+	for (int color = 0; color < 4; ++color) {
+		const int j0 = color%2, k0 = color/2;
+		const int n_rows_j = (ncj - j0 + 1)/2;
+		const int n_rows = n_rows_j*((nck - k0 + 1)/2);
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int r = 0; r < n_rows; ++r) {
+			int j = j0 + 2*(r%n_rows_j);
+			int k = k0 + 2*(r/n_rows_j);
+
+			/* the cells of a row are consecutive */
+			int c = domain.cell_at(0, j, k);
+			for (int q = offsets[c]; q < offsets[c + nci]; ++q)
+				deposit_particle<N>(f, order ? order[q] : q, kernel);
+		}
+	}
+}
+
+#endif
@@ -7,8 +7,6 @@ using namespace std;
 using namespace Eigen;
 using namespace Const;
 
-RandomNumberGenerator rng;
-
 Domain::Domain(string prefix, int ni, int nj, int nk) :
 	prefix{prefix}, ni{ni}, nj{nj}, nk{nk}, nn{ni, nj, nk}, n_nodes{ni*nj*nk},
 	n_cells{(ni - 1)*(nj - 1)*(nk - 1)}
@@ -106,20 +104,32 @@ Vector3d Domain::x_to_l(const Vector3d &x) const
 
 int Domain::x_to_c(const Vector3d &x) const
 {
-	Vector3i lInt = x_to_l(x).cast<int>();
-	return lInt(X) + lInt(Y)*(ni - 1) + lInt(Z)*(ni - 1)*(nj - 1);
+	Vector3i lInt = l_to_c(x_to_l(x));
+	return cell_at(lInt(X), lInt(Y), lInt(Z));
 }
 
 void Domain::scatter(VectorXd &f, const Vector3d &l, double value)
 {
-	int i = (int)l(X);
-	double di = l(X) - i;
+	Vector3i c = l_to_c(l);
+	scatter(f, c, l - c.cast<double>(), value);
+}
 
-	int j = (int)l(Y);
-	double dj = l(Y) - j;
+void Domain::scatter(MatrixXd &f, const Vector3d &l, const Vector3d &value)
+{
+	Vector3i c = l_to_c(l);
+	scatter(f, c, l - c.cast<double>(), value);
+}
 
-	int k = (int)l(Z);
-	double dk = l(Z) - k;
+Vector3d Domain::gather(const MatrixXd &f, const Vector3d &l) const
+{
+	Vector3i c = l_to_c(l);
+	return gather(f, c, l - c.cast<double>());
+}
+
+void Domain::scatter(VectorXd &f, const Vector3i &c, const Vector3d &d, double value)
+{
+	int i = c(X), j = c(Y), k = c(Z);
+	double di = d(X), dj = d(Y), dk = d(Z);
 
 	f(at(i    ,j    ,k    )) += value*(1 - di)*(1 - dj)*(1 - dk);
 	f(at(i + 1,j    ,k    )) += value*(    di)*(1 - dj)*(1 - dk);
@@ -131,16 +141,11 @@ void Domain::scatter(VectorXd &f, const Vector3d &l, double value)
 	f(at(i + 1,j + 1,k + 1)) += value*(    di)*(    dj)*(    dk);
 }
 
-void Domain::scatter(MatrixXd &f, const Vector3d &l, const Vector3d &value)
+void Domain::scatter(MatrixXd &f, const Vector3i &c, const Vector3d &d,
+		const Vector3d &value)
 {
-	int i = (int)l(X);
-	double di = l(X) - i;
-
-	int j = (int)l(Y);
-	double dj = l(Y) - j;
-
-	int k = (int)l(Z);
-	double dk = l(Z) - k;
+	int i = c(X), j = c(Y), k = c(Z);
+	double di = d(X), dj = d(Y), dk = d(Z);
 
 	f.row(at(i    ,j    ,k    )) += value*(1 - di)*(1 - dj)*(1 - dk);
 	f.row(at(i + 1,j    ,k    )) += value*(    di)*(1 - dj)*(1 - dk);
@@ -152,16 +157,10 @@ void Domain::scatter(MatrixXd &f, const Vector3d &l, const Vector3d &value)
 	f.row(at(i + 1,j + 1,k + 1)) += value*(    di)*(    dj)*(    dk);
 }
 
-Vector3d Domain::gather(const MatrixXd &f, const Vector3d &l) const
+Vector3d Domain::gather(const MatrixXd &f, const Vector3i &c, const Vector3d &d) const
 {
-	int i = (int)l(X);
-	double di = l(X) - i;
-
-	int j = (int)l(Y);
-	double dj = l(Y) - j;
-
-	int k = (int)l(Z);
-	double dk = l(Z) - k;
+	int i = c(X), j = c(Y), k = c(Z);
+	double di = d(X), dj = d(Y), dk = d(Z);
 
 	return f.row(at(i    ,j    ,k    ))*(1 - di)*(1 - dj)*(1 - dk)
 		 + f.row(at(i + 1,j    ,k    ))*(    di)*(1 - dj)*(1 - dk)
@@ -173,6 +172,115 @@ Vector3d Domain::gather(const MatrixXd &f, const Vector3d &l) const
 		 + f.row(at(i + 1,j + 1,k + 1))*(    di)*(    dj)*(    dk);
 }
 
+void Domain::set_field_layout(FieldLayout layout)
+{
+	field_layout = layout;
+	update_field_cache();
+}
+
+void Domain::update_field_cache()
+{
+	allocate_field_cache();
+	update_field_cache(0, nk);
+}
+
+void Domain::allocate_field_cache()
+{
+	E_nodes.clear();
+	E_cells.clear();
+
+	if (field_layout == FieldLayout::Interleaved)
+		E_nodes.resize(3*n_nodes);
+	else if (field_layout == FieldLayout::CellCache)
+		E_cells.resize(24*n_cells);
+}
+
+void Domain::update_field_cache(int k_begin, int k_end)
+{
+	if (field_layout == FieldLayout::Interleaved) {
+		for (int u = at(0, 0, k_begin); u < at(0, 0, k_end); ++u) {
+			for (int dim : {X, Y, Z})
+				E_nodes[3*u + dim] = E(u, dim);
+		}
+	} else if (field_layout == FieldLayout::CellCache) {
+		for (int k = k_begin; k < min(k_end, nk - 1); ++k) {
+			for (int j = 0; j < nj - 1; ++j) {
+				for (int i = 0; i < ni - 1; ++i) {
+					double *e = &E_cells[24*cell_at(i, j, k)];
+					const int u[8] = {
+						at(i    ,j    ,k    ), at(i + 1,j    ,k    ),
+						at(i    ,j + 1,k    ), at(i + 1,j + 1,k    ),
+						at(i    ,j    ,k + 1), at(i + 1,j    ,k + 1),
+						at(i    ,j + 1,k + 1), at(i + 1,j + 1,k + 1)};
+					for (int n = 0; n < 8; ++n) {
+						for (int dim : {X, Y, Z})
+							e[3*n + dim] = E(u[n], dim);
+					}
+				}
+			}
+		}
+	}
+}
+
+Vector3d Domain::gather_E(const Vector3d &l) const
+{
+	Vector3i c = l_to_c(l);
+	return gather_E(c, l - c.cast<double>());
+}
+
+Vector3d Domain::gather_E(const Vector3i &c, const Vector3d &d) const
+{
+	if (field_layout == FieldLayout::ColumnMajor)
+		return gather(E, c, d);
+
+	int i = c(X), j = c(Y), k = c(Z);
+	double di = d(X), dj = d(Y), dk = d(Z);
+
+	using Corners = Map<const Matrix<double, 3, 8>>;
+	if (field_layout == FieldLayout::CellCache) {
+		Corners e(&E_cells[24*cell_at(i, j, k)]);
+
+		return e.col(0)*(1 - di)*(1 - dj)*(1 - dk)
+			 + e.col(1)*(    di)*(1 - dj)*(1 - dk)
+			 + e.col(2)*(1 - di)*(    dj)*(1 - dk)
+			 + e.col(3)*(    di)*(    dj)*(1 - dk)
+			 + e.col(4)*(1 - di)*(1 - dj)*(    dk)
+			 + e.col(5)*(    di)*(1 - dj)*(    dk)
+			 + e.col(6)*(1 - di)*(    dj)*(    dk)
+			 + e.col(7)*(    di)*(    dj)*(    dk);
+	}
+
+	auto e = [&](int u) {return Map<const Vector3d>(&E_nodes[3*u]);};
+
+	return e(at(i    ,j    ,k    ))*(1 - di)*(1 - dj)*(1 - dk)
+		 + e(at(i + 1,j    ,k    ))*(    di)*(1 - dj)*(1 - dk)
+		 + e(at(i    ,j + 1,k    ))*(1 - di)*(    dj)*(1 - dk)
+		 + e(at(i + 1,j + 1,k    ))*(    di)*(    dj)*(1 - dk)
+		 + e(at(i    ,j,    k + 1))*(1 - di)*(1 - dj)*(    dk)
+		 + e(at(i + 1,j    ,k + 1))*(    di)*(1 - dj)*(    dk)
+		 + e(at(i    ,j + 1,k + 1))*(1 - di)*(    dj)*(    dk)
+		 + e(at(i + 1,j + 1,k + 1))*(    di)*(    dj)*(    dk);
+}
+
+Domain::FieldStencil Domain::get_E_stencil() const
+{
+	const int ninj = ni*nj;
+
+	switch (field_layout) {
+		case FieldLayout::Interleaved:
+			return {E_nodes.data(), {3, 3*ni, 3*ninj},
+				{0, 3, 3*ni, 3*(ni + 1), 3*ninj, 3*(ninj + 1), 3*(ninj + ni),
+					3*(ninj + ni + 1)}, 1};
+		case FieldLayout::CellCache:
+			return {E_cells.data(), {24, 24*(ni - 1), 24*(ni - 1)*(nj - 1)},
+				{0, 3, 6, 9, 12, 15, 18, 21}, 1};
+		default:
+			return {E.data(), {1, ni, ninj},
+				{0, 1, ni, ni + 1, ninj, ninj + 1, ninj + ni, ninj + ni + 1},
+				n_nodes};
+	}
+}
+
 void Domain::calc_charge_density(std::vector<Species> &species)
 {
 	rho.setZero();
@@ -198,7 +306,7 @@ void Domain::apply_boundary_conditions(const Species &sp, const Vector3d &x_old,
 	}
 }
 
-void Domain::eval_field_BC(BoundarySide side, VectorXd &b0, std::vector<T> &coeffs,
+int Domain::eval_field_BC(BoundarySide side, VectorXd &b0, std::vector<T> &coeffs,
 		int u, int v, double x, double y, double z) const
 {
 	for (const auto& _bc : bc.at(side)) {
@@ -207,7 +315,7 @@ void Domain::eval_field_BC(BoundarySide side, VectorXd &b0, std::vector<T> &coef
 				case FieldBCtype::Dirichlet:
 					coeffs.push_back(T(u, u, 1));
 					b0(u) = _bc->get_value(x, y, z);
-					break;
+					return _bc->get_electrode();
 				case FieldBCtype::Neumann:
 					coeffs.push_back(T(u, u,  1));
 					coeffs.push_back(T(u, v, -1));
@@ -222,6 +330,8 @@ void Domain::eval_field_BC(BoundarySide side, VectorXd &b0, std::vector<T> &coef
 			break;
 		}
 	}
+
+	return -1;
 }
 
 bool Domain::is_periodic(BoundarySide side) const
@@ -305,9 +415,10 @@ void Domain::eval_particle_BC(const Species &sp, int side, const Vector3d &X,
 Vector3d Domain::get_diffuse_vector(const Vector3d &n) const
 {
 	/* random vector that follows the cosine law */
-	double sin_theta = rng();
+	RandomNumberGenerator &gen = thread_rng();
+	double sin_theta = gen();
 	double cos_theta = sqrt(1 - sin_theta*sin_theta);
-	double psi = 2*PI*rng();
+	double psi = 2*PI*gen();
 
 	Vector3d t1;
 	if (n.cross(Vector3d::UnitX()).norm() != 0) {
@@ -377,9 +488,9 @@ void Domain::print_info(std::vector<Species> &species) const
 	for(const Species &sp : species) {
 		cout << "  " << sp.name << ":" << setw(6) << sp.get_sim_count();
 
-		for(const Particle &p : sp.particles)
-			if (p.v.norm() > v_max)
-				v_max = p.v.norm();
+		for (int p = 0; p < sp.get_sim_count(); ++p)
+			if (sp.particles.v(p).norm() > v_max)
+				v_max = sp.particles.v(p).norm();
 	}
 
 	cout << "  CFL: " << setprecision(3) << v_max*dt/del_x.minCoeff() << endl;
@@ -546,11 +657,11 @@ void Domain::save_particles(std::vector<Species> &species, int n_particles) cons
 
 		double dp = n_particles/(double)sp.get_sim_count();
 		double np = 0;
-		vector<const Particle *> p_out;
-		for(const Particle &p : sp.particles) {
+		vector<int> p_out;
+		for (int p = 0; p < sp.get_sim_count(); ++p) {
 			np += dp;
 			if (np > 1) {
-				p_out.push_back(&p);
+				p_out.push_back(p);
 				np -= 1;
 			}
 		}
@@ -566,16 +677,16 @@ void Domain::save_particles(std::vector<Species> &species, int n_particles) cons
 		out << "<Points>\n";
 		out << "<DataArray type=\"Float64\" NumberOfComponents=\"3\" "
 			<< "format=\"ascii\">\n";
-		for (const Particle *p : p_out)
-			out << p->x.transpose() << "\n";
+		for (int p : p_out)
+			out << sp.particles.x(p).transpose() << "\n";
 		out << "</DataArray>\n";
 		out << "</Points>\n";
 
 		out << "<PointData>\n";
 		out << "<DataArray Name=\"v." << sp.name
 			<< "\" type=\"Float64\" NumberOfComponents=\"3\" format=\"ascii\">\n";
-		for (const Particle *p : p_out)
-			out << p->v.transpose() << "\n";
+		for (int p : p_out)
+			out << sp.particles.v(p).transpose() << "\n";
 		out << "</DataArray>\n";
 		out << "</PointData>\n";
 
@@ -606,16 +717,19 @@ void Domain::save_velocity_histogram(std::vector<Species> &species) const
 		Vector3d v_max = Vector3d::Zero();
 		double v_mag_max = 0;
 
-		if (sp.particles.size() > 0) {
-			v_min = sp.particles[0].v;
-			v_max = sp.particles[0].v;
-			v_mag_max = sp.particles[0].v.norm();
+		const int n_sim = sp.get_sim_count();
+
+		if (n_sim > 0) {
+			v_min = sp.particles.v(0);
+			v_max = sp.particles.v(0);
+			v_mag_max = sp.particles.v(0).norm();
 		}
 
-		for(const Particle &p : sp.particles) {
-			v_min = v_min.cwiseMin(p.v);
-			v_max = v_max.cwiseMax(p.v);
-			v_mag_max = max(v_mag_max, p.v.norm());
+		for (int p = 0; p < n_sim; ++p) {
+			Vector3d v = sp.particles.v(p);
+			v_min = v_min.cwiseMin(v);
+			v_max = v_max.cwiseMax(v);
+			v_mag_max = max(v_mag_max, v.norm());
 		}
 
 		const double eps = 0.01;
@@ -627,12 +741,13 @@ void Domain::save_velocity_histogram(std::vector<Species> &species) const
 		dv << (v_max - v_min)/(n_bins - 1), v_mag_max/(n_bins - 1);
 
 		MatrixXd bins = MatrixXd::Zero(n_bins, 4);
-		for(const Particle &p : sp.particles) {
+		for (int p = 0; p < n_sim; ++p) {
+			Vector3d v = sp.particles.v(p);
 			for(int dim : {X, Y, Z}) {
-				bins(round((p.v(dim) - v_min(dim))/dv(dim)), dim)
-					+= 1/(dv(dim)*sp.particles.size());
+				bins((int)round((v(dim) - v_min(dim))/dv(dim)), dim)
+					+= 1/(dv(dim)*n_sim);
 			}
-			bins(round(p.v.norm()/dv(W)), W) += 1/(dv(W)*sp.particles.size());
+			bins((int)round(v.norm()/dv(W)), (int)W) += 1/(dv(W)*n_sim);
 		}
 
 		out << "v_x,f(v_x),v_y,f(v_y),v_z,f(v_z),v_mag,f(v_mag)\n";
@@ -19,6 +19,8 @@ enum class FieldBCtype {Dirichlet, Neumann, Periodic};
 
 enum class ParticleBCtype {Specular, Open, Diffuse, Symmetric, Periodic};
 
+enum class FieldLayout {ColumnMajor, Interleaved, CellCache};
+
 struct Particle;
 class Species;
 class Object;
@@ -68,6 +70,13 @@ class BC {
 
 		void set_delta(double delta) {this->delta = delta;}
 
+		/* Dirichlet BCs with the same electrode number form an electrode,
+		 * whose voltage Solver can change without being set up again, the
+		 * value of an electrode BC has to be constant */
+		void set_electrode(int electrode) {this->electrode = electrode;}
+
+		int get_electrode() const {return electrode;}
+
 		const ParticleBCtype particle_bc_type;
 		const FieldBCtype field_bc_type;
 
@@ -77,6 +86,7 @@ class BC {
 	private:
 		doubleFunc value = [](double, double, double){ return 0.0; };
 		double delta = 1.0;
+		int electrode = -1;
 
 		boolFunc _does_apply = [](double, double, double){ return true; };
 };
@@ -125,14 +135,70 @@ class Domain {
 
 		int x_to_c(const Vector3d &x) const;
 
+		/* cell of the logical coordinate l, a position just below x_max can
+		 * round to l = nn - 1, which still belongs to the last cell */
+		Vector3i l_to_c(const Vector3d &l) const {
+			return l.cast<int>().cwiseMin(nn - 2*Vector3i::Ones());
+		}
+
 		int at(int i, int j, int k) const {return i + j*ni + k*ni*nj;}
 
+		int cell_at(int i, int j, int k) const {
+			return i + j*(ni - 1) + k*(ni - 1)*(nj - 1);
+		}
+
 		void scatter(VectorXd &f, const Vector3d &l, double value);
 
 		void scatter(MatrixXd &f, const Vector3d &l, const Vector3d &value);
 
 		Vector3d gather(const MatrixXd &f, const Vector3d &l) const;
 
+		/* same as above, but with the cell index c and the offset d inside
+		 * the cell already split up, i.e. l = c + d */
+		void scatter(VectorXd &f, const Vector3i &c, const Vector3d &d, double value);
+
+		void scatter(MatrixXd &f, const Vector3i &c, const Vector3d &d,
+				const Vector3d &value);
+
+		Vector3d gather(const MatrixXd &f, const Vector3i &c, const Vector3d &d) const;
+
+		/* storage of E used for the gather of the particle push, ColumnMajor
+		 * reads E itself, Interleaved a copy of E with the 3 components of a
+		 * node next to each other and CellCache a copy of the 8 corner fields
+		 * of every cell in one contiguous block, the copies are rebuilt by
+		 * update_field_cache, which Solver::calc_electric_field calls */
+		void set_field_layout(FieldLayout layout);
+
+		FieldLayout get_field_layout() const {return field_layout;}
+
+		/* has to be called whenever E is changed by hand */
+		void update_field_cache();
+
+		/* update_field_cache in parts, allocate_field_cache sizes the copy,
+		 * update_field_cache(k_begin, k_end) then refreshes the nodes
+		 * (Interleaved) or cells (CellCache) of the planes k_begin <= k < k_end,
+		 * the cells of plane k need the node planes k and k + 1 of E */
+		void allocate_field_cache();
+
+		void update_field_cache(int k_begin, int k_end);
+
+		/* E at the logical coordinate l or at the offset d inside cell c */
+		Vector3d gather_E(const Vector3d &l) const;
+
+		Vector3d gather_E(const Vector3i &c, const Vector3d &d) const;
+
+		/* E component dim at corner n of cell (i, j, k), with the corners in
+		 * the order of gather, is data[i*stride[X] + j*stride[Y] + k*stride[Z]
+		 * + corner[n] + dim*comp_stride] */
+		struct FieldStencil {
+			const double *data;
+			int stride[3];
+			int corner[8];
+			int comp_stride;
+		};
+
+		FieldStencil get_E_stencil() const;
+
 		void calc_charge_density(std::vector<Species> &species);
 
 		void reverse_boundary_conditions() {
@@ -143,7 +209,8 @@ class Domain {
 		void apply_boundary_conditions(const Species &sp, const Vector3d &x_old,
 				Particle &p) const;
 
-		void eval_field_BC(BoundarySide side, VectorXd &b0, std::vector<T> &coeffs,
+		/* returns the electrode of the applied BC, or -1 */
+		int eval_field_BC(BoundarySide side, VectorXd &b0, std::vector<T> &coeffs,
 				int u, int v, double x, double y, double z) const;
 
 		bool is_periodic(BoundarySide side) const;
@@ -195,6 +262,10 @@ class Domain {
 
 		Vector3d x_min, x_max, del_x;
 
+		FieldLayout field_layout = FieldLayout::ColumnMajor;
+		std::vector<double> E_nodes;	/* [V/m] E interleaved per node */
+		std::vector<double> E_cells;	/* [V/m] E at the 8 corners of every cell */
+
 		std::map<int, std::vector<std::unique_ptr<BC>>> bc;
 
 		double time = 0, dt;
@@ -1,16 +1,26 @@
+#include <numeric>
 #include "interaction.hpp"
 #include "const.hpp"
+#include "simd.hpp"
 
 using namespace std;
 using namespace Eigen;
 using namespace Const;
 
+Interaction::Interaction()
+{
+	auto &gen = rng.get_gen();
+	seed = (uint64_t)gen() << 32 | gen();
+}
+
 DSMC_Bird::DSMC_Bird(Domain &domain, Species &species) :
 	domain{domain}, species{species}
 {
 	n_cells = domain.n_cells;
 	V = domain.get_del_x().prod();
 
+	sigma_vr_max.assign(n_cells, 0.0);
+
 	w_mp = species.w_mp0;
 
 	m = species.m;
@@ -27,47 +37,81 @@ DSMC_Bird::DSMC_Bird(Domain &domain, Species &species) :
 
 void DSMC_Bird::apply(double dt)
 {
-	vector<vector<Particle *>> pic(n_cells);
-	for(Particle &p : species.particles) {
-		int c = domain.x_to_c(p.x);
-		pic[c].push_back(&p);
-	}
+	Particles &particles = species.particles;
+	const Species::CellIndex &index = species.get_cell_index();
 
-	int n_collisions = 0;
-	double sigma_vr_max_tmp = 0;
+	long n_candidates = 0, n_collisions = 0;
 
+	/* the cells are independent, every cell draws from its own stream */
+	#pragma omp parallel for schedule(dynamic, 64) \
+		reduction(+:n_candidates, n_collisions)
 	for (int c = 0; c < n_cells; ++c) {
-		int N_p = pic[c].size();
+		/* particles of cell c */
+		const int *pic = index.order.data() + index.offsets[c];
+		int N_p = index.offsets[c + 1] - index.offsets[c];
 		if (N_p < 2) continue;
 
-		/* Bird's No Time Counter */
-		int N_g = (int)(0.5*N_p*N_p*w_mp*sigma_vr_max*dt/V + rng());
+		RandomStream gen = stream(c, 0);
+
+		/* the first samples of a cell are drawn with a generous guess */
+		bool sampled = sigma_vr_max[c] > 0;
+		if (!sampled)
+			sigma_vr_max[c] = sigma_vr_max0;
+
+		/* Bird's No Time Counter with the majorant of the cell */
+		int N_g = (int)(0.5*N_p*N_p*w_mp*sigma_vr_max[c]*dt/V + gen());
+		double sigma_vr_max_cell = 0;
 
 		for (int g = 0; g < N_g; ++g) {
-			Particle *p1, *p2;
+			int p1, p2;
 
-			p1 = pic[c][(int)(N_p*rng())];
+			p1 = pic[(int)(N_p*gen())];
 			do {
-				p2 = pic[c][(int)(N_p*rng())];
+				p2 = pic[(int)(N_p*gen())];
 			} while(p2 == p1);
 
-			double vr_mag = (p1->v - p2->v).norm();
+			Vector3d v1 = particles.v(p1);
+			Vector3d v2 = particles.v(p2);
+
+			double vr_mag = (v1 - v2).norm();
 			double sigma_vr = sigma(vr_mag)*vr_mag;
 
-			if (sigma_vr > sigma_vr_max_tmp)
-				sigma_vr_max_tmp = sigma_vr;
+			if (sigma_vr > sigma_vr_max_cell)
+				sigma_vr_max_cell = sigma_vr;
 
-			double P = sigma_vr/sigma_vr_max;
+			double P = sigma_vr/sigma_vr_max[c];
 
-			if (P > rng()) {
+			if (P > gen()) {
 				++n_collisions;
-				collide(p1->v, p2->v, m, m);
+				collide(v1, v2, m, m, gen);
+				particles.set_v(p1, v1);
+				particles.set_v(p2, v2);
 			}
 		}
+
+		/* a cold population lowers the majorant slowly, a sample above it
+		 * raises it at once, the guess is replaced by the first samples */
+		if (sigma_vr_max_cell > 0) {
+			sigma_vr_max[c] = sampled ? max(sigma_vr_max_cell, decay*sigma_vr_max[c])
+				: sigma_vr_max_cell;
+		} else if (!sampled) {
+			sigma_vr_max[c] = 0;
+		}
+
+		n_candidates += N_g;
 	}
 
-	if (n_collisions > 0)
-		sigma_vr_max = sigma_vr_max_tmp;
+	this->n_candidates = n_candidates;
+	this->n_collisions = n_collisions;
+
+	++step;
+}
+
+void DSMC_Bird::print_info() const
+{
+	cout << "  DSMC " << species.name << ": candidates:" << setw(8) << n_candidates
+		 << "  collisions:" << setw(8) << n_collisions
+		 << "  acceptance: " << setprecision(3) << get_acceptance_ratio() << endl;
 }
 
 double DSMC_Bird::sigma(double vr_mag) const
@@ -77,16 +121,17 @@ double DSMC_Bird::sigma(double vr_mag) const
 	return PI*d*d;
 }
 
-void DSMC_Bird::collide(Vector3d &v1, Vector3d &v2, double m1, double m2) const
+void DSMC_Bird::collide(Vector3d &v1, Vector3d &v2, double m1, double m2,
+		RandomStream &gen) const
 {
 	Vector3d vm = (m1*v1 + m2*v2)/(m1 + m2);
 
 	double vr_mag = (v2 - v1).norm();
 
 	/* isotropic scattering angle */
-	double cos_xi = 2*rng() - 1;
+	double cos_xi = 2*gen() - 1;
 	double sin_xi = sqrt(1- cos_xi*cos_xi);
-	double eps = 2*PI*rng();
+	double eps = 2*PI*gen();
 
 	Vector3d vr = {
 		vr_mag*cos_xi,
@@ -100,57 +145,84 @@ void DSMC_Bird::collide(Vector3d &v1, Vector3d &v2, double m1, double m2) const
 
 
 DSMC_Nanbu::DSMC_Nanbu(Domain &domain, vector<Species> &species, double T_e,
-		double n_e) :
+		double n_e, double table_tolerance) :
 	domain{domain}, species{species}
 {
 	n_species = species.size();
 	n_cells = domain.n_cells;
 
 	lambda_D = sqrt(EPS0*K*T_e/(n_e*QE*QE));
+
+	if (table_tolerance > 0)
+		table = make_unique<CoulombTable>(make_coulomb_table(table_tolerance));
 }
 
-void DSMC_Nanbu::apply(double dt)
+void DSMC_Nanbu::print_info() const
 {
-	vector<vector<vector<Particle *>>> sic(n_species);
-	for(int s = 0; s < n_species; ++s) {
-		vector<vector<Particle *>> pic(n_cells);
+	if (table)
+		cout << "  DSMC Nanbu: scattering table:" << setw(8) << table->data.size()*sizeof(float)
+			 << " B  max error: " << setprecision(3) << table->max_error << endl;
+}
 
-		for(Particle &p : species[s].particles) {
-			int c = domain.x_to_c(p.x);
-			pic[c].push_back(&p);
-		}
+struct DSMC_Nanbu::PairBatch {
+	vector<int> i1, i2;
 
-		sic[s] = pic;
+	/* pairs that share a particle are put into consecutive rounds, the
+	 * pairs of a round are independent, the buffers are sorted by round,
+	 * pos[k] is the position of pair k in the buffers and pair[q] the pair
+	 * at position q */
+	vector<int> round, next1, next2, first, pos, pair;
+	vector<double> v1[3], v2[3], u_xi, u_eps;
+
+	void clear() {i1.clear(); i2.clear();}
+	void add(int p1, int p2) {i1.push_back(p1); i2.push_back(p2);}
+};
+
+void DSMC_Nanbu::apply(double dt)
+{
+	/* the particles are shuffled within their cells, hence a copy of the
+	 * cell index of every species */
+	order.resize(n_species);
+	vector<const int *> offsets(n_species);
+	for (int s = 0; s < n_species; ++s) {
+		const Species::CellIndex &index = species[s].get_cell_index();
+		order[s] = index.order;
+		offsets[s] = index.offsets.data();
 	}
 
-	/* perform like collisions */
+	/* perform like collisions, the cells are independent and every cell
+	 * draws from its own stream */
 	for (int s = 0; s < n_species; ++s) {
+		#pragma omp parallel for schedule(dynamic, 64)
 		for (int c = 0; c < n_cells; ++c) {
+			static thread_local PairBatch batch;
 
-			/* reference to the particles of species s in the cell c */
-			vector<Particle *> &pic = sic[s][c];
+			/* the particles of species s in the cell c */
+			int *pic = order[s].data() + offsets[s][c];
 
 			/* number particles */
-			int N = pic.size();
+			int N = offsets[s][c + 1] - offsets[s][c];
 
 			if (N > 1) {
+				RandomStream gen = stream(c, s*n_species + s);
 
 				/* shuffle the particles of species s in cell c */
-				std::shuffle(pic.begin(), pic.end(), rng.get_gen());
-
-				/* get total temperature in cell c */
-				double T_tot = domain.T_tot(c);
+				std::shuffle(pic, pic + N, gen.get_gen());
 
-				/* collide N/2 parts */
+				/* pair N/2 parts */
+				batch.clear();
 				for (int i = 0; i + 1 < N; i += 2)
-					collide(pic[i]->v, pic[i + 1]->v, species[s].m, species[s].m,
-						T_tot, species[s].q, species[s].q, species[s].n_mean[c], dt);
-
+					batch.add(i, i + 1);
 
 				/* handle odd particle numbers */
 				if (N%2 != 0)
-					collide(pic[N - 1]->v, pic[0]->v, species[s].m, species[s].m,
-						T_tot, species[s].q, species[s].q, species[s].n_mean[c], dt);
+					batch.add(N - 1, 0);
+
+				double s_factor = collision_factor(domain.T_tot(c), species[s].m,
+						species[s].m, species[s].q, species[s].q, species[s].n_mean[c], dt);
+
+				collide(batch, species[s].particles, pic, N, species[s].particles, pic, N,
+						true, species[s].m, species[s].m, s_factor, gen);
 			}
 
 		}
@@ -159,122 +231,87 @@ void DSMC_Nanbu::apply(double dt)
 	/* perform unlike collisions */
 	for (int s1 = 0; s1 < n_species - 1; ++s1) {
 		for (int s2 = s1 + 1; s2 < n_species; ++s2) {
+			#pragma omp parallel for schedule(dynamic, 64)
 			for (int c = 0; c < n_cells; ++c) {
+				static thread_local PairBatch batch;
 
-				/* reference to the particles of species s1/s2 in the cell c */
-				vector<Particle *> &pic1 = sic[s1][c];
-				vector<Particle *> &pic2 = sic[s2][c];
+				/* the particles of species s1/s2 in the cell c */
+				int *pic1 = order[s1].data() + offsets[s1][c];
+				int *pic2 = order[s2].data() + offsets[s2][c];
 
 				/* number particles */
-				int N1 = pic1.size();
-				int N2 = pic2.size();
-
-				if (N1 == 0 || N2 == 0) {
-					break;
+				int N1 = offsets[s1][c + 1] - offsets[s1][c];
+				int N2 = offsets[s2][c + 1] - offsets[s2][c];
 
-				} else if (N1 == N2) {
+				RandomStream gen = stream(c, s1*n_species + s2);
 
-					/* shuffle the particles of species s1/s2 in cell c */
-					std::shuffle(pic1.begin(), pic1.end(), rng.get_gen());
-					std::shuffle(pic2.begin(), pic2.end(), rng.get_gen());
+				if (N1 == 0 || N2 == 0)
+					continue;
 
-					/* get total temperature in cell c */
-					double T_tot = domain.T_tot(c);
+				/* shuffle the particles of species s1/s2 in cell c */
+				if (N2 > N1) {
+					std::shuffle(pic2, pic2 + N2, gen.get_gen());
+					std::shuffle(pic1, pic1 + N1, gen.get_gen());
+				} else {
+					std::shuffle(pic1, pic1 + N1, gen.get_gen());
+					std::shuffle(pic2, pic2 + N2, gen.get_gen());
+				}
 
-					/* collide N1 == N2 parts */
-					for (int i = 0; i < N1; ++i)
-						collide(pic1[i]->v, pic2[i]->v,
-								species[s1].m, species[s2].m, T_tot,
-								species[s1].q, species[s2].q,
-								species[s2].n_mean[c], dt);
+				/* the more numerous species is a, the particles of b are
+				 * selected several times */
+				int a = N1 >= N2 ? s1 : s2;
+				int b = N1 >= N2 ? s2 : s1;
+				int *pica = N1 >= N2 ? pic1 : pic2;
+				int *picb = N1 >= N2 ? pic2 : pic1;
+				int Na = max(N1, N2);
+				int Nb = min(N1, N2);
 
-				} else if (N1 > N2) {
+				batch.clear();
+				if (Na == Nb) {
 
-					/* shuffle the particles of species s1/s2 in cell c */
-					std::shuffle(pic1.begin(), pic1.end(), rng.get_gen());
-					std::shuffle(pic2.begin(), pic2.end(), rng.get_gen());
+					/* collide N1 == N2 parts */
+					for (int i = 0; i < Na; ++i)
+						batch.add(i, i);
 
-					/* get total temperature in cell c */
-					double T_tot = domain.T_tot(c);
+				} else {
 
 					/* devide the particles into two groups */
-					int i = N1/N2;
-					double r = N1/(double)N2 - i;
+					int i = Na/Nb;
+					double r = Na/(double)Nb - i;
 
 					/* number of particles in group 1 */
-					int N1g1 = (int)((i + 1)*r*N2);
-					int N2g1 = (int)(r*N2);
+					int Nag1 = (int)((i + 1)*r*Nb);
+					int Nbg1 = (int)(r*Nb);
 
-					/* collide first group, particles of species 2 are
+					/* collide first group, particles of species b are
 					 * selected (i + 1) times */
-					for (int j = 0; j < N1g1; ++j)
-						collide(pic1[j]->v, pic2[(int)(j/(i + 1))]->v,
-								species[s1].m, species[s2].m, T_tot,
-								species[s1].q, species[s2].q,
-								species[s2].n_mean[c], dt);
+					for (int j = 0; j < Nag1; ++j)
+						batch.add(j, (int)(j/(i + 1)));
 
 					/* number of particles in group 2 */
-					int N1g2 = (int)(i*(1 - r)*N2);
-					//int N2g2 = (int)((1 - r)*N2);
+					int Nag2 = (int)(i*(1 - r)*Nb);
 
-					/* collide second group, particles of species 2 are
+					/* collide second group, particles of species b are
 					 * selected i times */
-					for (int j = 0; j < N1g2; ++j)
-						collide(pic1[N1g1 + j]->v, pic2[N2g1 + (int)(j/i)]->v,
-								species[s1].m, species[s2].m, T_tot,
-								species[s1].q, species[s2].q,
-								species[s2].n_mean[c], dt);
-
-				} else if (N2 > N1) {
-
-					/* shuffle the particles of species s1/s2 in cell c */
-					std::shuffle(pic2.begin(), pic2.end(), rng.get_gen());
-					std::shuffle(pic1.begin(), pic1.end(), rng.get_gen());
-
-					/* get total temperature in cell c */
-					double T_tot = domain.T_tot(c);
-
-					/* devide the particles into two groups */
-					int i = N2/N1;
-					double r = N2/(double)N1 - i;
-
-					/* number of particles in group 1 */
-					int N2g1 = (int)((i + 1)*r*N1);
-					int N1g1 = (int)(r*N1);
+					for (int j = 0; j < Nag2; ++j)
+						batch.add(Nag1 + j, Nbg1 + (int)(j/i));
+				}
 
-					/* collide first group, particles of species 1 are
-					 * selected (i + 1) times */
-					for (int j = 0; j < N2g1; ++j)
-						collide(pic2[j]->v, pic1[(int)(j/(i + 1))]->v,
-								species[s2].m, species[s1].m, T_tot,
-								species[s2].q, species[s1].q,
-								species[s1].n_mean[c], dt);
+				double s_factor = collision_factor(domain.T_tot(c), species[a].m,
+						species[b].m, species[a].q, species[b].q, species[b].n_mean[c], dt);
 
-					/* number of particles in group 2 */
-					int N2g2 = (int)(i*(1 - r)*N1);
-					//int N1g2 = (int)((1 - r)*N1);
-
-					/* collide second group, particles of species 2 are
-					 * selected i times */
-					for (int j = 0; j < N2g2; ++j)
-						collide(pic2[N2g1 + j]->v, pic1[N1g1 + (int)(j/i)]->v,
-								species[s2].m, species[s1].m, T_tot,
-								species[s2].q, species[s1].q,
-								species[s1].n_mean[c], dt);
-				}
+				collide(batch, species[a].particles, pica, Na, species[b].particles, picb, Nb,
+						false, species[a].m, species[b].m, s_factor, gen);
 			}
 		}
 	}
+
+	++step;
 }
 
-void DSMC_Nanbu::collide(Vector3d &v1, Vector3d &v2, double m1, double m2,
-		double T_tot, double q1, double q2, double n2, double dt) const
+double DSMC_Nanbu::collision_factor(double T_tot, double m1, double m2, double q1,
+		double q2, double n2, double dt) const
 {
-	/* relative velocity */
-	Vector3d g = v1 - v2;
-	double g_mag = g.norm();
-	double g_perp = sqrt(g(Y)*g(Y) + g(Z)*g(Z));
-
 	/* calculate coulomb logarithm */
 	double ln_Lambda = log(lambda_D*2*PI*EPS0*3*K*T_tot/fabs(q1*q2));
 	if (ln_Lambda < 0.0) ln_Lambda = 0.0;
@@ -282,61 +319,109 @@ void DSMC_Nanbu::collide(Vector3d &v1, Vector3d &v2, double m1, double m2,
 	/* calculate mass ratio */
 	double mu = m1*m2/(m1 + m2);
 
-	/* calculate collision parameter */
-	double s = ln_Lambda/(4*PI)*pow(q1*q2/(EPS0*mu), 2)*n2*pow(g_mag, -3)*dt;
+	double f = q1*q2/(EPS0*mu);
+	return ln_Lambda/(4*PI)*f*f*n2*dt;
+}
 
-	/* calculate cosine and sine of scattering angle */
-	double cos_xi;
-	if (s < 0.1) {
-		cos_xi = 1 + s*log(rng());
-	} else if (0.1 <= s && s < 3.0) {
-		double A_inv = 0.0056958 + 0.9560202*s - 0.508139*s*s
-			+ 0.47913906*s*s*s - 0.12788975*s*s*s*s + 0.02389567*s*s*s*s*s;
+void DSMC_Nanbu::collide(PairBatch &batch, Particles &particles1, const int *pic1,
+		int N1, Particles &particles2, const int *pic2, int N2, bool like, double m1,
+		double m2, double s_factor, RandomStream &gen) const
+{
+	const int n = batch.i1.size();
+	const vector<int> &i1 = batch.i1;
+	const vector<int> &i2 = batch.i2;
+
+	/* a pair waits for the earlier pairs of its particles */
+	vector<int> &next1 = batch.next1;
+	vector<int> &next2 = like ? batch.next1 : batch.next2;
+	next1.assign(N1, 0);
+	if (!like)
+		next2.assign(N2, 0);
+
+	batch.round.resize(n);
+	int n_rounds = 0;
+	for (int k = 0; k < n; ++k) {
+		int r = max(next1[i1[k]], next2[i2[k]]);
+		batch.round[k] = r;
+		next1[i1[k]] = next2[i2[k]] = r + 1;
+		n_rounds = max(n_rounds, r + 1);
+	}
 
-		double A = 1.0/A_inv;
+	/* sort the pairs by round, first[r] is the first pair of round r */
+	vector<int> &first = batch.first;
+	first.assign(n_rounds + 1, 0);
+	for (int k = 0; k < n; ++k)
+		++first[batch.round[k] + 1];
+	partial_sum(first.begin(), first.end(), first.begin());
+
+	batch.pos.resize(n);
+	batch.pair.resize(n);
+	for (int k = 0; k < n; ++k) {
+		batch.pos[k] = first[batch.round[k]]++;
+		batch.pair[batch.pos[k]] = k;
+	}
+	for (int r = n_rounds; r > 0; --r)
+		first[r] = first[r - 1];
+	first[0] = 0;
 
-		cos_xi = A_inv*log(exp(-A) + 2.0*rng()*sinh(A));
-	} else if (3.0 <= s && s < 6.0) {
-		double A = 3.0*exp(-s);
+	for (int d = 0; d < 3; ++d) {
+		batch.v1[d].resize(n);
+		batch.v2[d].resize(n);
+	}
+	batch.u_xi.resize(n);
+	batch.u_eps.resize(n);
 
-		cos_xi = 1.0/A*log(exp(-A) + 2.0*rng()*sinh(A));
-	} else {
-		cos_xi = 2.0*rng() - 1.0;
+	/* the random numbers are drawn in the order of the pairs */
+	for (int k = 0; k < n; ++k) {
+		batch.u_xi[batch.pos[k]] = gen();
+		batch.u_eps[batch.pos[k]] = gen();
 	}
 
-	double sin_xi = sqrt(1 - cos_xi*cos_xi);
+	CoulombKernel kernel = get_coulomb_kernel();
 
-	/* calculate binary collision parameter */
-	double eps = 2*PI*rng();
-	Vector3d h = {
-		g_perp*cos(eps),
-		-(g(Y)*g(X)*cos(eps) + g_mag*g(Z)*sin(eps))/g_perp,
-		-(g(Z)*g(X)*cos(eps) - g_mag*g(Y)*sin(eps))/g_perp
-	};
+	for (int r = 0; r < n_rounds; ++r) {
+		int begin = first[r];
+		int end = first[r + 1];
 
-	/* perfom binary collision */
-	v1 -= m2/(m1 + m2)*(g*(1 - cos_xi) + h*sin_xi);
-	v2 += m1/(m1 + m2)*(g*(1 - cos_xi) + h*sin_xi);
-
-	if (!(isfinite(v1(X)) && isfinite(v1(Y)) && isfinite(v1(Z))) || !(isfinite(v2(X)) && isfinite(v2(Y)) && isfinite(v2(Z)))) {
-
-		cout << "m1    = " << m1 << endl
-			 << "m2    = " << m2 << endl
-			 << "T_tot = " << T_tot << endl
-			 << "q1    = " << q1 << endl
-			 << "q2    = " << q2 << endl
-			 << "n2    = " << n2 << endl
-			 << "dt    = " << dt << endl
-			 << "g     = " << g.transpose() << endl
-			 << "v1    = " << g.transpose() << endl
-			 << "v2    = " << g.transpose() << endl;
-
-		assert(isfinite(v1(X)));
-		assert(isfinite(v1(Y)));
-		assert(isfinite(v1(Z)));
-
-		assert(isfinite(v2(X)));
-		assert(isfinite(v2(Y)));
-		assert(isfinite(v2(Z)));
+		/* gather */
+		for (int q = begin; q < end; ++q) {
+			int k = batch.pair[q];
+
+			Vector3d v1 = particles1.v(pic1[i1[k]]);
+			Vector3d v2 = particles2.v(pic2[i2[k]]);
+			for (int d = 0; d < 3; ++d) {
+				batch.v1[d][q] = v1(d);
+				batch.v2[d][q] = v2(d);
+			}
+		}
+
+		CoulombKernelArgs args = {
+			{batch.v1[X].data() + begin, batch.v1[Y].data() + begin, batch.v1[Z].data() + begin},
+			{batch.v2[X].data() + begin, batch.v2[Y].data() + begin, batch.v2[Z].data() + begin},
+			batch.u_xi.data() + begin, batch.u_eps.data() + begin,
+			m1, m2, s_factor, table.get()
+		};
+		kernel(args, end - begin);
+
+		/* scatter */
+		for (int q = begin; q < end; ++q) {
+			int k = batch.pair[q];
+
+			Vector3d v1(batch.v1[X][q], batch.v1[Y][q], batch.v1[Z][q]);
+			Vector3d v2(batch.v2[X][q], batch.v2[Y][q], batch.v2[Z][q]);
+
+			if (!isfinite(v1.sum() + v2.sum())) {
+				cout << "m1       = " << m1 << endl
+					 << "m2       = " << m2 << endl
+					 << "s_factor = " << s_factor << endl
+					 << "v1       = " << particles1.v(pic1[i1[k]]).transpose() << endl
+					 << "v2       = " << particles2.v(pic2[i2[k]]).transpose() << endl;
+
+				assert(isfinite(v1.sum() + v2.sum()));
+			}
+
+			particles1.set_v(pic1[i1[k]], v1);
+			particles2.set_v(pic2[i2[k]], v2);
+		}
 	}
 }
@@ -2,16 +2,32 @@
 #define INTERACTION_HPP
 
 #include <map>
+#include <memory>
 #include <string>
+#include <cstdint>
 #include <Eigen/Dense>
 #include "domain.hpp"
 #include "species.hpp"
+#include "random.hpp"
 
 class Interaction {
 	public:
+		Interaction();
+
 		virtual void apply(double dt) = 0;
 
+		/* statistics of the last apply */
+		virtual void print_info() const {}
+
 		virtual ~Interaction() {}
+
+	protected:
+		/* random numbers of cell c and the species pair in the current step,
+		 * the cells can be collided in parallel in any order */
+		RandomStream stream(int c, int pair) const {return RandomStream(seed, step, c, pair);}
+
+		std::uint64_t seed;		/* drawn from rng */
+		std::uint64_t step = 0;	/* calls of apply */
 };
 
 class DSMC_Bird : public Interaction {
@@ -23,6 +39,20 @@ class DSMC_Bird : public Interaction {
 
 		void apply(double dt) override;
 
+		void print_info() const override;
+
+		/* the majorant of a cell decays by this factor per step towards the
+		 * largest sigma*v_r sampled in the cell */
+		void set_majorant_decay(double decay) {this->decay = decay;}
+
+		/* candidate pairs and collisions of the last apply */
+		long get_candidates() const {return n_candidates;}
+		long get_collisions() const {return n_collisions;}
+
+		double get_acceptance_ratio() const {
+			return n_candidates > 0 ? n_collisions/(double)n_candidates : 0;
+		}
+
 	private:
 		Domain &domain;
 		Species &species;
@@ -46,24 +76,36 @@ class DSMC_Bird : public Interaction {
 		double V;		/* [m^3] cell volume */
 		double w_mp;	/* [-] macroparticle weight */
 
-		double sigma_vr_max = 1e-14;
+		/* [m^3/s] majorant of sigma*v_r of every cell, 0 until the cell
+		 * was sampled, the initial guess is sigma_vr_max0 */
+		std::vector<double> sigma_vr_max;
+		const double sigma_vr_max0 = 1e-14;
+		double decay = 0.95;
+
+		long n_candidates = 0, n_collisions = 0;
 
 		double mr, m;	/* [kg] reduced mass, species mass */
 		double df;		/* [m^2] VHS diameter factor squared */
 
 		double sigma(double v_r) const;
 
-		void collide(Vector3d &v1, Vector3d &v2, double m1, double m2) const;
+		void collide(Vector3d &v1, Vector3d &v2, double m1, double m2,
+				RandomStream &gen) const;
 };
 
 class DSMC_Nanbu : public Interaction {
 	public:
 		using Vector3d = Eigen::Vector3d;
 
-		DSMC_Nanbu(Domain &domain, std::vector<Species> &species, double Te, double ne);
+		/* the scattering angle is sampled from a CoulombTable with error below
+		 * table_tolerance if it is positive, from the analytic form otherwise */
+		DSMC_Nanbu(Domain &domain, std::vector<Species> &species, double Te, double ne,
+				double table_tolerance = 0);
 
 		void apply(double dt) override;
 
+		void print_info() const override;
+
 	private:
 		Domain &domain;
 		std::vector<Species> &species;
@@ -73,8 +115,28 @@ class DSMC_Nanbu : public Interaction {
 		int n_cells;
 		int n_species;
 
-		void collide(Vector3d &v1, Vector3d &v2, double m1, double m2,
-				double T_tot, double q1, double q2, double n2, double dt) const;
+		std::unique_ptr<CoulombTable> table;	/* nullptr for the analytic form */
+
+		/* particles of every species grouped by cell, shuffled within the
+		 * cells, kept to reuse the memory */
+		std::vector<std::vector<int>> order;
+
+		/* pairs of a cell and their velocities in contiguous buffers, one
+		 * per thread */
+		struct PairBatch;
+
+		/* s = s_factor/g^3 of a pair with relative velocity g, the Coulomb
+		 * logarithm only depends on the temperature of the cell */
+		double collision_factor(double T_tot, double m1, double m2, double q1,
+				double q2, double n2, double dt) const;
+
+		/* collide the pairs of batch, a pair (i1, i2) collides the particles
+		 * pic1[i1] of particles1 and pic2[i2] of particles2, like collisions
+		 * pass the same particles twice, the result equals colliding the pairs
+		 * one after the other */
+		void collide(PairBatch &batch, Particles &particles1, const int *pic1, int N1,
+				Particles &particles2, const int *pic2, int N2, bool like, double m1,
+				double m2, double s_factor, RandomStream &gen) const;
 };
 
 #endif
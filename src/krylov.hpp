@@ -0,0 +1,147 @@
+#ifndef KRYLOV_HPP
+#define KRYLOV_HPP
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <Eigen/Dense>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Krylov solvers for operators that are not stored as a matrix,
+ * op(x, y) has to compute y = A x and precond(r, z) z = M^-1 r, the
+ * iteration and the stopping criterion follow Eigen::BiCGSTAB, so that the
+ * results are comparable to the assembled path
+ *
+ * the vector operations run on n_threads threads, every thread works on a
+ * contiguous block of the vectors and the partial dot products are summed
+ * in a fixed order, so a solve only depends on the number of threads, with
+ * one thread the operations are the plain Eigen expressions */
+
+/* block(begin, size) for the blocks of [0, n) of n_threads threads */
+template <typename Block>
+void for_blocks(int n, int n_threads, Block &&block)
+{
+	if (n_threads <= 1) {
+		block(0, n);
+		return;
+	}
+
+	#pragma omp parallel num_threads(n_threads)
+	{
+		int t = 0, n_team = 1;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		n_team = omp_get_num_threads();
+#endif
+		int begin = (long)n*t/n_team;
+		int end = (long)n*(t + 1)/n_team;
+		block(begin, end - begin);
+	}
+}
+
+inline double parallel_dot(const Eigen::VectorXd &a, const Eigen::VectorXd &b,
+		int n_threads)
+{
+	if (n_threads <= 1)
+		return a.dot(b);
+
+	std::vector<double> partial(n_threads, 0.0);
+	for_blocks(a.size(), n_threads, [&](int begin, int size) {
+		int t = 0;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+#endif
+		partial[t] = a.segment(begin, size).dot(b.segment(begin, size));
+	});
+
+	double sum = 0;
+	for (double p : partial)
+		sum += p;
+
+	return sum;
+}
+
+/* solve A x = b starting from x, returns the number of iterations or -1 if
+ * the relative residual error is still above tol after iter_max iterations */
+template <typename Operator, typename Preconditioner>
+int bicgstab(Operator &&op, Preconditioner &&precond, const Eigen::VectorXd &b,
+		Eigen::VectorXd &x, int iter_max, double tol, double &error, int n_threads = 1)
+{
+	using Eigen::VectorXd;
+
+	auto dot = [n_threads](const VectorXd &u, const VectorXd &v) {
+		return parallel_dot(u, v, n_threads);
+	};
+
+	const int n = b.size();
+	const double b_sqnorm = dot(b, b);
+	if (b_sqnorm == 0) {
+		x.setZero();
+		error = 0;
+		return 0;
+	}
+
+	VectorXd r(n), y(n), z(n), s(n), t(n);
+	VectorXd v = VectorXd::Zero(n), p = VectorXd::Zero(n);
+
+	op(x, t);
+	for_blocks(n, n_threads, [&](int i, int m) {
+		r.segment(i, m) = b.segment(i, m) - t.segment(i, m);
+	});
+	VectorXd r0 = r;
+	double r0_sqnorm = dot(r0, r0);
+
+	const double threshold = tol*tol*b_sqnorm;
+	const double eps2 = std::pow(std::numeric_limits<double>::epsilon(), 2);
+
+	double rho = 1, alpha = 1, w = 1;
+	int iter = 0, restarts = 0;
+
+	while (dot(r, r) > threshold && iter < iter_max) {
+		double rho_old = rho;
+		rho = dot(r0, r);
+
+		/* r0 became too orthogonal to r, restart with the current residual */
+		if (std::abs(rho) < eps2*r0_sqnorm) {
+			op(x, t);
+			for_blocks(n, n_threads, [&](int i, int m) {
+				r.segment(i, m) = b.segment(i, m) - t.segment(i, m);
+			});
+			r0 = r;
+			rho = r0_sqnorm = dot(r, r);
+			if (restarts++ == 0)
+				iter = 0;
+		}
+
+		double beta = (rho/rho_old)*(alpha/w);
+		for_blocks(n, n_threads, [&](int i, int m) {
+			p.segment(i, m) = r.segment(i, m) + beta*(p.segment(i, m) - w*v.segment(i, m));
+		});
+
+		precond(p, y);
+		op(y, v);
+		alpha = rho/dot(r0, v);
+		for_blocks(n, n_threads, [&](int i, int m) {
+			s.segment(i, m) = r.segment(i, m) - alpha*v.segment(i, m);
+		});
+
+		precond(s, z);
+		op(z, t);
+		double t_sqnorm = dot(t, t);
+		w = t_sqnorm > 0 ? dot(t, s)/t_sqnorm : 0;
+
+		for_blocks(n, n_threads, [&](int i, int m) {
+			x.segment(i, m) += alpha*y.segment(i, m) + w*z.segment(i, m);
+			r.segment(i, m) = s.segment(i, m) - w*t.segment(i, m);
+		});
+		++iter;
+	}
+
+	error = std::sqrt(dot(r, r)/b_sqnorm);
+	return error <= tol ? iter : -1;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include "multigrid.hpp"
+
+using namespace std;
+using namespace Eigen;
+
+using T = Triplet<double>;
+
+Multigrid::RowSpMat Multigrid::prolongation_1d(int n, int &n_coarse)
+{
+	vector<T> coeffs;
+
+	/* too few nodes left, keep all of them */
+	if (n <= 3) {
+		n_coarse = n;
+		for (int f = 0; f < n; ++f)
+			coeffs.push_back(T(f, f, 1));
+
+	/* coarse node I sits on fine node 2I, the last coarse node on the last
+	 * fine node, also for an even number of nodes */
+	} else {
+		n_coarse = n/2 + 1;
+		auto pos = [&](int I) {return min(2*I, n - 1);};
+
+		for (int f = 0; f < n; ++f) {
+			int I = f/2;
+			if (pos(I) == f) {
+				coeffs.push_back(T(f, I, 1));
+			} else {
+				double w = double(f - pos(I))/(pos(I + 1) - pos(I));
+				coeffs.push_back(T(f, I, 1 - w));
+				coeffs.push_back(T(f, I + 1, w));
+			}
+		}
+	}
+
+	RowSpMat P(n, n_coarse);
+	P.setFromTriplets(coeffs.begin(), coeffs.end());
+	return P;
+}
+
+void Multigrid::setup(const SpMat &A, const Vector3i &nn)
+{
+	levels.clear();
+
+	/* scale the rows to a unit diagonal, so that the boundary rows and the
+	 * rows of the Laplacian have the same weight on the coarse grids, empty
+	 * rows (nodes without any applicable BC) are left as they are */
+	row_scale = A.diagonal();
+	for (int u = 0; u < row_scale.size(); ++u)
+		row_scale(u) = row_scale(u) != 0 ? 1/row_scale(u) : 1;
+
+	levels.emplace_back();
+	levels.back().A = row_scale.asDiagonal()*A;
+
+	Vector3i n = nn;
+	while (true) {
+		Level &level = levels.back();
+
+		level.inv_diag = level.A.diagonal();
+		for (int u = 0; u < level.inv_diag.size(); ++u)
+			level.inv_diag(u) = level.inv_diag(u) != 0 ? 1/level.inv_diag(u) : 0;
+
+		Vector3i n_c;
+		RowSpMat P1[3];
+		for (int dim = 0; dim < 3; ++dim)
+			P1[dim] = prolongation_1d(n(dim), n_c(dim));
+
+		if (level.A.rows() <= coarse_size || n_c == n)
+			break;
+
+		/* nodes with a fixed value keep the value the smoother gives them */
+		vector<bool> fixed(level.A.rows());
+		for (int u = 0; u < level.A.rows(); ++u) {
+			RowSpMat::InnerIterator it(level.A, u);
+			fixed[u] = it && it.col() == u && !(++it);
+		}
+
+		/* trilinear prolongation as tensor product of the 1D ones */
+		vector<T> coeffs;
+		for (int k = 0; k < n(2); ++k) {
+			for (int j = 0; j < n(1); ++j) {
+				for (int i = 0; i < n(0); ++i) {
+					int u = i + j*n(0) + k*n(0)*n(1);
+					if (fixed[u])
+						continue;
+
+					for (RowSpMat::InnerIterator it_k(P1[2], k); it_k; ++it_k) {
+						for (RowSpMat::InnerIterator it_j(P1[1], j); it_j; ++it_j) {
+							for (RowSpMat::InnerIterator it_i(P1[0], i); it_i; ++it_i) {
+								int U = it_i.col() + it_j.col()*n_c(0)
+									+ it_k.col()*n_c(0)*n_c(1);
+								coeffs.push_back(T(u, U,
+											it_i.value()*it_j.value()*it_k.value()));
+							}
+						}
+					}
+				}
+			}
+		}
+
+		level.P.resize(level.A.rows(), n_c.prod());
+		level.P.setFromTriplets(coeffs.begin(), coeffs.end());
+		level.R = level.P.transpose();
+
+		/* Galerkin coarse operator */
+		SpMat A_c = level.R*(level.A*level.P);
+		A_c.prune(0.0);
+
+		/* coarse nodes without any fine node to correct */
+		for (int U = 0; U < A_c.rows(); ++U) {
+			if (A_c.coeff(U, U) == 0)
+				A_c.coeffRef(U, U) = 1;
+		}
+
+		levels.emplace_back();
+		levels.back().A = A_c;
+		n = n_c;
+	}
+
+	coarse_solver.compute(SpMat(levels.back().A));
+}
+
+void Multigrid::smooth(const Level &level, VectorXd &x, const VectorXd &b,
+		bool forward) const
+{
+	const int n = level.A.rows();
+
+	for (int s = 0; s < n; ++s) {
+		int u = forward ? s : n - 1 - s;
+
+		double r = b(u);
+		for (RowSpMat::InnerIterator it(level.A, u); it; ++it)
+			r -= it.value()*x(it.col());
+
+		x(u) += r*level.inv_diag(u);
+	}
+}
+
+void Multigrid::cycle(int l, VectorXd &x, const VectorXd &b) const
+{
+	const Level &level = levels[l];
+
+	if (l == (int)levels.size() - 1) {
+		if (coarse_solver.info() == Success) {
+			x = coarse_solver.solve(b);
+		} else {
+			/* singular coarse operator, e.g. for a fully periodic domain */
+			for (int s = 0; s < 10*(n_pre + n_post); ++s)
+				smooth(level, x, b, s%2 == 0);
+		}
+		return;
+	}
+
+	for (int s = 0; s < n_pre; ++s)
+		smooth(level, x, b, true);
+
+	VectorXd r = b - level.A*x;
+	VectorXd x_c = VectorXd::Zero(level.P.cols());
+	cycle(l + 1, x_c, level.R*r);
+	x += level.P*x_c;
+
+	for (int s = 0; s < n_post; ++s)
+		smooth(level, x, b, false);
+}
+
+Multigrid::VectorXd Multigrid::vcycle(const VectorXd &b) const
+{
+	VectorXd x = VectorXd::Zero(b.size());
+	cycle(0, x, row_scale.cwiseProduct(b));
+	return x;
+}
+
+int Multigrid::solve(VectorXd &x, const VectorXd &b, int iter_max, double tol) const
+{
+	const double b_norm = b.norm();
+	if (b_norm == 0) {
+		x.setZero();
+		error = 0;
+		return 0;
+	}
+
+	const VectorXd b_scaled = row_scale.cwiseProduct(b);
+
+	for (int iter = 0; iter <= iter_max; ++iter) {
+		/* the residual of the scaled system, the error is measured on the
+		 * original one */
+		VectorXd r = b_scaled - levels[0].A*x;
+		error = r.cwiseQuotient(row_scale).norm()/b_norm;
+
+		if (error < tol)
+			return iter;
+
+		if (iter < iter_max) {
+			VectorXd e = VectorXd::Zero(b.size());
+			cycle(0, e, r);
+			x += e;
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,107 @@
+#ifndef MULTIGRID_HPP
+#define MULTIGRID_HPP
+
+#include <vector>
+#include <Eigen/Eigen>
+
+/* geometric multigrid for the field equations on the structured ni x nj x nk
+ * mesh of Domain
+ *
+ * the rows of A are scaled to a unit diagonal, the coarse grids take every
+ * other node in each direction that has more than 3 nodes and the coarse
+ * operators are built by the Galerkin product R*A*P with trilinear
+ * prolongation P and restriction R = P^T, so that every boundary condition
+ * the fine operator encodes, including periodic wraps and masked electrodes,
+ * carries over to the coarse grids, nodes with a fixed value (identity rows)
+ * are not corrected from the coarse grids, the smoother is Gauss-Seidel and
+ * the coarsest grid is solved directly */
+class Multigrid {
+	public:
+		using SpMat = Eigen::SparseMatrix<double>;
+		using RowSpMat = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+		using Vector3i = Eigen::Vector3i;
+		using VectorXd = Eigen::VectorXd;
+
+		/* build the grid hierarchy for the operator A on a mesh with nn nodes */
+		void setup(const SpMat &A, const Vector3i &nn);
+
+		bool is_setup() const {return !levels.empty();}
+
+		void set_smoothing(int n_pre, int n_post) {
+			this->n_pre = n_pre;
+			this->n_post = n_post;
+		}
+
+		/* [-] grids with at most this many nodes are solved directly */
+		void set_coarse_size(int coarse_size) {this->coarse_size = coarse_size;}
+
+		int get_levels() const {return (int)levels.size();}
+
+		/* approximation of A^-1 b by a single V-cycle starting from zero */
+		VectorXd vcycle(const VectorXd &b) const;
+
+		/* V-cycles on A x = b until the relative residual drops below tol,
+		 * returns the number of cycles, or -1 if iter_max is exceeded */
+		int solve(VectorXd &x, const VectorXd &b, int iter_max, double tol) const;
+
+		double get_error() const {return error;}
+
+	private:
+		struct Level {
+			RowSpMat A;			/* scaled operator */
+			VectorXd inv_diag;
+			SpMat P;			/* prolongation to this level from the next one */
+			SpMat R;			/* restriction from this level to the next one */
+		};
+
+		void cycle(int l, VectorXd &x, const VectorXd &b) const;
+
+		void smooth(const Level &level, VectorXd &x, const VectorXd &b,
+				bool forward) const;
+
+		static RowSpMat prolongation_1d(int n, int &n_coarse);
+
+		std::vector<Level> levels;
+		Eigen::SparseLU<SpMat> coarse_solver;
+
+		SpMat A_fine;			/* unscaled fine operator */
+		VectorXd row_scale;		/* 1/diag(A) of the fine operator */
+
+		int n_pre = 2, n_post = 2;
+		int coarse_size = 4096;
+
+		mutable double error = 0;
+};
+
+/* adapter that lets Eigen's iterative solvers use a V-cycle as
+ * preconditioner, the hierarchy is built beforehand with Multigrid::setup,
+ * compute() does not rebuild it, so that e.g. the Newton iteration of the
+ * Boltzmann electron model keeps using the hierarchy of the Poisson operator */
+class MultigridPreconditioner {
+	public:
+		using VectorXd = Eigen::VectorXd;
+
+		MultigridPreconditioner() = default;
+
+		void set_multigrid(const Multigrid *mg) {this->mg = mg;}
+
+		template <typename MatrixType>
+		MultigridPreconditioner &analyzePattern(const MatrixType &) {return *this;}
+
+		template <typename MatrixType>
+		MultigridPreconditioner &factorize(const MatrixType &) {return *this;}
+
+		template <typename MatrixType>
+		MultigridPreconditioner &compute(const MatrixType &) {return *this;}
+
+		VectorXd solve(const VectorXd &b) const {return mg->vcycle(b);}
+
+		Eigen::ComputationInfo info() const {
+			return mg && mg->is_setup() ? Eigen::Success : Eigen::InvalidInput;
+		}
+
+	private:
+		const Multigrid *mg = nullptr;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "particles.hpp"
+
+using namespace std;
+using namespace Eigen;
+
+void Particles::reserve(int n)
+{
+	for (int dim = 0; dim < 3; ++dim) {
+		if (is_single()) {
+			xf_[dim].reserve(n);
+			vf_[dim].reserve(n);
+		} else {
+			x_[dim].reserve(n);
+			v_[dim].reserve(n);
+		}
+		if (is_cell_relative())
+			c_[dim].reserve(n);
+	}
+	dt_.reserve(n);
+	w_mp_.reserve(n);
+}
+
+void Particles::resize(int n)
+{
+	for (int dim = 0; dim < 3; ++dim) {
+		if (is_single()) {
+			xf_[dim].resize(n);
+			vf_[dim].resize(n);
+		} else {
+			x_[dim].resize(n);
+			v_[dim].resize(n);
+		}
+		if (is_cell_relative())
+			c_[dim].resize(n);
+	}
+	dt_.resize(n);
+	w_mp_.resize(n);
+}
+
+void Particles::push_back(const Particle &p)
+{
+	resize(size() + 1);
+	set(size() - 1, p);
+}
+
+void Particles::set(int p, const Particle &particle)
+{
+	set_x(p, particle.x);
+	set_v(p, particle.v);
+	dt_[p] = particle.dt;
+	w_mp_[p] = particle.w_mp;
+}
+
+void Particles::set_x(int p, const Vector3d &x)
+{
+	if (!is_cell_relative()) {
+		for (int dim = 0; dim < 3; ++dim)
+			set_position(p, dim, x(dim));
+		return;
+	}
+
+	for (int dim = 0; dim < 3; ++dim) {
+		double l = (x(dim) - x_min(dim))/del_x(dim);
+
+		/* keep the cell index valid, even for particles that just left
+		 * the domain, the offset then lies outside of [0, 1) */
+		int c = (int)floor(l);
+		c = max(0, min(c, n_cells(dim) - 1));
+
+		c_[dim][p] = c;
+		set_position(p, dim, l - c);
+
+		/* the offset of a particle inside the domain has to stay below 1
+		 * after rounding to the storage precision */
+		if (is_single() && xf_[dim][p] == 1.0f && l < n_cells(dim))
+			xf_[dim][p] = nextafter(1.0f, 0.0f);
+	}
+}
+
+void Particles::copy(int src, int dst)
+{
+	for (int dim = 0; dim < 3; ++dim) {
+		if (is_single()) {
+			xf_[dim][dst] = xf_[dim][src];
+			vf_[dim][dst] = vf_[dim][src];
+		} else {
+			x_[dim][dst] = x_[dim][src];
+			v_[dim][dst] = v_[dim][src];
+		}
+		if (is_cell_relative())
+			c_[dim][dst] = c_[dim][src];
+	}
+	dt_[dst] = dt_[src];
+	w_mp_[dst] = w_mp_[src];
+}
+
+void Particles::reorder(const vector<int> &order)
+{
+	for (int dim = 0; dim < 3; ++dim) {
+		if (is_single()) {
+			reorder(xf_[dim], scratch_float, order);
+			reorder(vf_[dim], scratch_float, order);
+		} else {
+			reorder(x_[dim], scratch, order);
+			reorder(v_[dim], scratch, order);
+		}
+		if (is_cell_relative())
+			reorder(c_[dim], scratch_int, order);
+	}
+	reorder(dt_, scratch, order);
+	reorder(w_mp_, scratch, order);
+}
+
+void Particles::set_encoding(PositionEncoding encoding, const Vector3d &x_min,
+		const Vector3d &del_x, const Vector3i &n_cells)
+{
+	vector<Vector3d> x(size());
+	for (int p = 0; p < size(); ++p)
+		x[p] = this->x(p);
+
+	this->encoding = encoding;
+	this->x_min = x_min;
+	this->del_x = del_x;
+	this->n_cells = n_cells;
+
+	for (int dim = 0; dim < 3; ++dim) {
+		if (is_cell_relative()) {
+			c_[dim].resize(size());
+		} else {
+			c_[dim].clear();
+			c_[dim].shrink_to_fit();
+		}
+	}
+
+	for (int p = 0; p < size(); ++p)
+		set_x(p, x[p]);
+}
+
+template <typename T>
+void Particles::reorder(AlignedVector<T> &f, AlignedVector<T> &scratch,
+		const vector<int> &order)
+{
+	scratch.resize(order.size());
+	for (size_t p = 0; p < order.size(); ++p)
+		scratch[p] = f[order[p]];
+	f.swap(scratch);
+}
@@ -0,0 +1,252 @@
+#ifndef PARTICLES_HPP
+#define PARTICLES_HPP
+
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <Eigen/Dense>
+
+/* allocator that aligns every array to a full cache line, so that the
+ * particle arrays can be streamed with aligned SIMD loads */
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+	using value_type = T;
+
+	template <typename U>
+	struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+	T *allocate(std::size_t n) {
+		return static_cast<T *>(::operator new(n*sizeof(T),
+					std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T *p, std::size_t) {
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment> &) const {return true;}
+
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment> &) const {return false;}
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+/* a single unpacked particle, used wherever a particle is handled on its
+ * own, e.g. when it is injected or when it hits a boundary */
+struct Particle {
+	using Vector3d = Eigen::Vector3d;
+
+	Particle(const Vector3d &x, const Vector3d &v, double dt, double w_mp) :
+		x{x}, v{v}, dt{dt}, w_mp{w_mp} {}
+
+	Vector3d x;		/* [m] particle position */
+	Vector3d v;		/* [m/s] particle velocity */
+	double dt;		/* [s] particle time step */
+	double w_mp;	/* [-] macro particle weight */
+};
+
+enum class PositionEncoding {Absolute, CellRelative};
+
+enum class Precision {Double, Single};
+
+/* structure of arrays particle storage, every particle property is kept
+ * in its own contiguous array, so that the hot loops only stream the
+ * properties they actually need
+ *
+ * with PositionEncoding::CellRelative the position is not stored as an
+ * absolute coordinate, but as the integer index of the cell the particle
+ * is in plus the normalized offset [0, 1) inside that cell, x_data then
+ * returns the offsets and c_data the cell indices
+ *
+ * with Precision::Single positions and velocities are stored as float,
+ * x_data<float>/v_data<float> have to be used to access them, all other
+ * properties and all the accessors returning Vector3d stay double */
+class Particles {
+	public:
+		using Vector3i = Eigen::Vector3i;
+		using Vector3d = Eigen::Vector3d;
+
+		explicit Particles(Precision precision = Precision::Double) :
+			precision{precision} {}
+
+		int size() const {return (int)w_mp_.size();}
+
+		bool empty() const {return w_mp_.empty();}
+
+		void reserve(int n);
+
+		void resize(int n);
+
+		void clear() {resize(0);}
+
+		void push_back(const Particle &p);
+
+		Particle get(int p) const {return Particle(x(p), v(p), dt_[p], w_mp_[p]);}
+
+		void set(int p, const Particle &particle);
+
+		/* overwrite particle dst with particle src */
+		void copy(int src, int dst);
+
+		/* keep only the particles listed in order, in that order */
+		void reorder(const std::vector<int> &order);
+
+		/* switch the position encoding, existing particles are converted,
+		 * x_min/del_x/n_cells describe the cells of the mesh */
+		void set_encoding(PositionEncoding encoding, const Vector3d &x_min,
+				const Vector3d &del_x, const Vector3i &n_cells);
+
+		PositionEncoding get_encoding() const {return encoding;}
+
+		bool is_cell_relative() const {
+			return encoding == PositionEncoding::CellRelative;
+		}
+
+		Precision get_precision() const {return precision;}
+
+		bool is_single() const {return precision == Precision::Single;}
+
+		/* call f(double()) or f(float()) depending on the storage precision,
+		 * so that a generic lambda can pick the matching component arrays */
+		template <typename F>
+		auto visit(F &&f) const {
+			if (is_single())
+				return f(float());
+			return f(double());
+		}
+
+		Vector3d x(int p) const {
+			if (is_cell_relative())
+				return x_min + (cell(p).cast<double>() + offset(p)).cwiseProduct(del_x);
+			return offset(p);
+		}
+
+		/* stored position components, i.e. the position for the absolute
+		 * and the offset inside the cell for the cell relative encoding */
+		Vector3d offset(int p) const {
+			if (is_single())
+				return {xf_[0][p], xf_[1][p], xf_[2][p]};
+			return {x_[0][p], x_[1][p], x_[2][p]};
+		}
+
+		/* cell index, only valid for the cell relative encoding */
+		Vector3i cell(int p) const {return {c_[0][p], c_[1][p], c_[2][p]};}
+
+		Vector3d v(int p) const {
+			if (is_single())
+				return {vf_[0][p], vf_[1][p], vf_[2][p]};
+			return {v_[0][p], v_[1][p], v_[2][p]};
+		}
+
+		double dt(int p) const {return dt_[p];}
+
+		double w_mp(int p) const {return w_mp_[p];}
+
+		void set_x(int p, const Vector3d &x);
+
+		void set_v(int p, const Vector3d &v) {
+			if (is_single()) {
+				vf_[0][p] = v(0); vf_[1][p] = v(1); vf_[2][p] = v(2);
+			} else {
+				v_[0][p] = v(0); v_[1][p] = v(1); v_[2][p] = v(2);
+			}
+		}
+
+		void set_dt(int p, double dt) {dt_[p] = dt;}
+
+		void set_w_mp(int p, double w_mp) {w_mp_[p] = w_mp;}
+
+		/* raw access to the component arrays for the hot loops */
+		template <typename Real = double>
+		Real *x_data(int dim) {return positions<Real>()[dim].data();}
+
+		template <typename Real = double>
+		Real *v_data(int dim) {return velocities<Real>()[dim].data();}
+
+		double *dt_data() {return dt_.data();}
+		double *w_mp_data() {return w_mp_.data();}
+		int *c_data(int dim) {return c_[dim].data();}
+
+		template <typename Real = double>
+		const Real *x_data(int dim) const {return positions<Real>()[dim].data();}
+
+		template <typename Real = double>
+		const Real *v_data(int dim) const {return velocities<Real>()[dim].data();}
+
+		const double *dt_data() const {return dt_.data();}
+		const double *w_mp_data() const {return w_mp_.data();}
+		const int *c_data(int dim) const {return c_[dim].data();}
+
+	private:
+		const Precision precision;
+
+		/* [m] particle position or [-] cell offset, [m/s] particle velocity,
+		 * only the set matching the precision is used */
+		AlignedVector<double> x_[3], v_[3];
+		AlignedVector<float> xf_[3], vf_[3];
+
+		AlignedVector<double> dt_;		/* [s] particle time step */
+		AlignedVector<double> w_mp_;	/* [-] macro particle weight */
+		AlignedVector<int> c_[3];		/* [-] cell index, only if cell relative */
+
+		PositionEncoding encoding = PositionEncoding::Absolute;
+		Vector3d x_min = Vector3d::Zero();
+		Vector3d del_x = Vector3d::Ones();
+		Vector3i n_cells = Vector3i::Zero();
+
+		/* buffers used by reorder */
+		AlignedVector<double> scratch;
+		AlignedVector<float> scratch_float;
+		AlignedVector<int> scratch_int;
+
+		template <typename Real> AlignedVector<Real> *positions();
+		template <typename Real> AlignedVector<Real> *velocities();
+		template <typename Real> const AlignedVector<Real> *positions() const;
+		template <typename Real> const AlignedVector<Real> *velocities() const;
+
+		void set_position(int p, int dim, double x) {
+			if (is_single()) {
+				xf_[dim][p] = x;
+			} else {
+				x_[dim][p] = x;
+			}
+		}
+
+		template <typename T>
+		static void reorder(AlignedVector<T> &f, AlignedVector<T> &scratch,
+				const std::vector<int> &order);
+};
+
+template <>
+inline AlignedVector<double> *Particles::positions<double>() {return x_;}
+
+template <>
+inline AlignedVector<float> *Particles::positions<float>() {return xf_;}
+
+template <>
+inline AlignedVector<double> *Particles::velocities<double>() {return v_;}
+
+template <>
+inline AlignedVector<float> *Particles::velocities<float>() {return vf_;}
+
+template <>
+inline const AlignedVector<double> *Particles::positions<double>() const {return x_;}
+
+template <>
+inline const AlignedVector<float> *Particles::positions<float>() const {return xf_;}
+
+template <>
+inline const AlignedVector<double> *Particles::velocities<double>() const {return v_;}
+
+template <>
+inline const AlignedVector<float> *Particles::velocities<float>() const {return vf_;}
+
+#endif
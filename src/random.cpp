@@ -0,0 +1,18 @@
+#include "random.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+RandomNumberGenerator rng;
+
+RandomNumberGenerator &thread_rng()
+{
+#ifdef _OPENMP
+	if (omp_get_thread_num() > 0) {
+		static thread_local RandomNumberGenerator local_rng;
+		return local_rng;
+	}
+#endif
+	return rng;
+}
@@ -2,6 +2,7 @@
 #define RANDOM_HPP
 
 #include <random>
+#include <cstdint>
 #include <Eigen/Dense>
 
 class RandomNumberGenerator {
@@ -34,4 +35,50 @@ class RandomNumberGenerator {
 
 extern RandomNumberGenerator rng;
 
+/* splitmix64, a generator with a single 64 bit word of state, which is
+ * cheap enough to start a new stream for every cell */
+class SplitMix64 {
+	public:
+		using result_type = std::uint64_t;
+
+		explicit SplitMix64(std::uint64_t state) : state{state} {}
+
+		static constexpr result_type min() {return 0;}
+		static constexpr result_type max() {return ~result_type(0);}
+
+		result_type operator()() {return mix(state += 0x9e3779b97f4a7c15);}
+
+		/* bijective finalizer of splitmix64 */
+		static std::uint64_t mix(std::uint64_t z) {
+			z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27))*0x94d049bb133111eb;
+			return z ^ (z >> 31);
+		}
+
+	private:
+		std::uint64_t state;
+};
+
+/* random numbers that only depend on a key, e.g. (seed, step, cell, pair),
+ * so that work split over threads by key gives the same results for any
+ * number of threads */
+class RandomStream {
+	public:
+		RandomStream(std::uint64_t seed, std::uint64_t step, std::uint64_t cell,
+				std::uint64_t pair) :
+			gen{SplitMix64::mix(SplitMix64::mix(SplitMix64::mix(seed ^ step) ^ cell) ^ pair)} {}
+
+		/* uniform in [0, 1) */
+		double operator()() {return (gen() >> 11)*0x1.0p-53;}
+
+		SplitMix64 &get_gen() {return gen;}
+
+	private:
+		SplitMix64 gen;
+};
+
+/* generator of the calling thread, this is rng outside of parallel regions
+ * and on the master thread, every other OpenMP thread gets its own stream */
+RandomNumberGenerator &thread_rng();
+
 #endif
@@ -0,0 +1,195 @@
+#include "reduced.hpp"
+
+using namespace std;
+using namespace Eigen;
+
+bool ReducedSystem::setup(const SpMat &A, const Domain &domain)
+{
+	using RowSpMat = SparseMatrix<double, RowMajor>;
+
+	const int n_nodes = domain.n_nodes;
+	RowSpMat A_row = A;
+
+	/* classify the rows, the inner neighbor of a Neumann node is next */
+	enum Kind {Regular, Dirichlet, Neumann, Duplicate};
+	vector<Kind> kind(n_nodes, Regular);
+	next.assign(n_nodes, -1);
+
+	for (int u = 0; u < n_nodes; ++u) {
+		int n_entries = 0, v = -1;
+		double diag = 0, off = 0;
+		for (RowSpMat::InnerIterator it(A_row, u); it; ++it, ++n_entries) {
+			if (it.col() == u) {
+				diag = it.value();
+			} else {
+				v = it.col();
+				off = it.value();
+			}
+		}
+
+		/* nodes without any field equation */
+		if (n_entries == 0)
+			return false;
+
+		if (n_entries == 1 && diag == 1) {
+			kind[u] = Dirichlet;
+		} else if (n_entries == 2 && diag == 1 && off == -1) {
+			kind[u] = Neumann;
+			next[u] = v;
+		}
+	}
+
+	/* the last node of a periodic direction duplicates the first one */
+	const int nn[3] = {domain.ni, domain.nj, domain.nk};
+	const bool periodic[3] = {domain.is_periodic(Xmin), domain.is_periodic(Ymin),
+		domain.is_periodic(Zmin)};
+
+	vector<int> partner(n_nodes, -1);
+	for (int k = 0; k < nn[2]; ++k) {
+		for (int j = 0; j < nn[1]; ++j) {
+			for (int i = 0; i < nn[0]; ++i) {
+				int idx[3] = {i, j, k};
+				bool duplicate = false;
+				for (int dim = 0; dim < 3; ++dim) {
+					if (periodic[dim] && idx[dim] == nn[dim] - 1) {
+						idx[dim] = 0;
+						duplicate = true;
+					}
+				}
+
+				int u = domain.at(i,j,k);
+				int v = domain.at(idx[0], idx[1], idx[2]);
+				if (duplicate && kind[u] == Regular && kind[v] == Regular) {
+					kind[u] = Duplicate;
+					partner[u] = v;
+				}
+			}
+		}
+	}
+
+	nodes.clear();
+	unknown.assign(n_nodes, -1);
+	for (int u = 0; u < n_nodes; ++u) {
+		if (kind[u] == Regular) {
+			unknown[u] = nodes.size();
+			nodes.push_back(u);
+		}
+	}
+
+	/* follow the Neumann chains inwards until they end in an unknown or a
+	 * Dirichlet node, the chain is then resolved from the inside out */
+	source.assign(n_nodes, -1);
+	order.clear();
+	vector<bool> resolved(n_nodes, false);
+
+	for (int u = 0; u < n_nodes; ++u) {
+		if (kind[u] == Regular || resolved[u])
+			continue;
+
+		vector<int> chain;
+		int e = u;
+		while (kind[e] == Neumann && !resolved[e]) {
+			chain.push_back(e);
+			e = next[e];
+
+			/* a closed chain has no value to start from */
+			if ((int)chain.size() > n_nodes)
+				return false;
+		}
+
+		/* e ends the chain */
+		int end_source = -1;
+		if (kind[e] == Regular) {
+			end_source = unknown[e];
+		} else {
+			if (!resolved[e]) {
+				source[e] = kind[e] == Duplicate ? unknown[partner[e]] : -1;
+				resolved[e] = true;
+				order.push_back(e);
+			}
+			end_source = source[e];
+		}
+
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+			source[*it] = end_source;
+			resolved[*it] = true;
+			order.push_back(*it);
+		}
+	}
+
+	/* K = -A on the unknowns, the couplings to eliminated nodes go to the
+	 * unknown they follow and to the right hand side */
+	vector<Triplet<double>> K_coeffs, E_coeffs;
+	for (int r = 0; r < (int)nodes.size(); ++r) {
+		for (RowSpMat::InnerIterator it(A_row, nodes[r]); it; ++it) {
+			int c = it.col();
+			if (unknown[c] >= 0) {
+				K_coeffs.push_back(Triplet<double>(r, unknown[c], -it.value()));
+			} else {
+				E_coeffs.push_back(Triplet<double>(r, c, it.value()));
+				if (source[c] >= 0)
+					K_coeffs.push_back(Triplet<double>(r, source[c], -it.value()));
+			}
+		}
+	}
+
+	K.resize(nodes.size(), nodes.size());
+	K.setFromTriplets(K_coeffs.begin(), K_coeffs.end());
+	K.prune(0.0);
+
+	E.resize(nodes.size(), n_nodes);
+	E.setFromTriplets(E_coeffs.begin(), E_coeffs.end());
+
+	SpMat asymmetry = K - SpMat(K.transpose());
+	return asymmetry.norm() <= 1e-12*K.norm();
+}
+
+ReducedSystem::VectorXd ReducedSystem::offsets(const VectorXd &b) const
+{
+	VectorXd offset = VectorXd::Zero(b.size());
+
+	for (int e : order) {
+		if (next[e] >= 0) {
+			/* Neumann, x_e - x_next = b_e */
+			offset(e) = b(e) + (unknown[next[e]] < 0 ? offset(next[e]) : 0);
+		} else if (source[e] < 0) {
+			/* Dirichlet */
+			offset(e) = b(e);
+		}
+	}
+
+	return offset;
+}
+
+ReducedSystem::VectorXd ReducedSystem::reduce(const VectorXd &b) const
+{
+	VectorXd f = E*offsets(b);
+
+	for (int r = 0; r < (int)nodes.size(); ++r)
+		f(r) -= b(nodes[r]);
+
+	return f;
+}
+
+ReducedSystem::VectorXd ReducedSystem::restrict_to_unknowns(const VectorXd &x) const
+{
+	VectorXd y(nodes.size());
+
+	for (int r = 0; r < (int)nodes.size(); ++r)
+		y(r) = x(nodes[r]);
+
+	return y;
+}
+
+void ReducedSystem::expand(const VectorXd &y, const VectorXd &b, VectorXd &x) const
+{
+	x = offsets(b);
+
+	for (int r = 0; r < (int)nodes.size(); ++r)
+		x(nodes[r]) = y(r);
+
+	for (int e : order) {
+		if (source[e] >= 0)
+			x(e) += y(source[e]);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef REDUCED_HPP
+#define REDUCED_HPP
+
+#include <vector>
+#include <Eigen/Eigen>
+#include "domain.hpp"
+
+/* the field equations A x = b with the boundary nodes eliminated
+ *
+ * Dirichlet nodes (identity rows) are known, Neumann nodes (rows u - v) are
+ * replaced by their inner neighbor v plus the prescribed difference and the
+ * last node of a periodic direction is merged with the first one, what is
+ * left are the rows of the Laplacian, K = -A restricted to them is
+ * symmetric positive definite and can be solved with conjugate gradients */
+class ReducedSystem {
+	public:
+		using SpMat = Eigen::SparseMatrix<double>;
+		using VectorXd = Eigen::VectorXd;
+
+		/* eliminate the boundary nodes of the operator A assembled for domain,
+		 * returns false if what is left is not symmetric */
+		bool setup(const SpMat &A, const Domain &domain);
+
+		const SpMat &get_matrix() const {return K;}
+
+		int get_size() const {return (int)nodes.size();}
+
+		/* right hand side of K y = f for A x = b */
+		VectorXd reduce(const VectorXd &b) const;
+
+		/* unknowns y of the full vector x */
+		VectorXd restrict_to_unknowns(const VectorXd &x) const;
+
+		/* full solution x from the solution y of K y = reduce(b) */
+		void expand(const VectorXd &y, const VectorXd &b, VectorXd &x) const;
+
+	private:
+		/* x_e = offset_e + x(source[e]) for the eliminated nodes e, the
+		 * offsets depend on b and are summed along the Neumann chains */
+		VectorXd offsets(const VectorXd &b) const;
+
+		SpMat K;
+		SpMat E;						/* couplings of the unknowns to eliminated nodes */
+
+		std::vector<int> nodes;			/* node of every unknown */
+		std::vector<int> unknown;		/* unknown of every node, -1 if eliminated */
+		std::vector<int> source;		/* unknown an eliminated node follows, or -1 */
+		std::vector<int> next;			/* inner neighbor of a Neumann node, or -1 */
+		std::vector<int> order;			/* eliminated nodes, inner ones first */
+};
+
+#endif
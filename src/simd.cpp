@@ -0,0 +1,1057 @@
+#include <cmath>
+#include <algorithm>
+#include "simd.hpp"
+#include "const.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void stencil_scalar(const double *x, double *y, int n, int sj, int sk,
+		const double *c)
+{
+	for (int i = 0; i < n; ++i) {
+		y[i] = c[0]*x[i] + c[1]*(x[i - 1] + x[i + 1]) + c[2]*(x[i - sj] + x[i + sj])
+			+ c[3]*(x[i - sk] + x[i + sk]);
+	}
+}
+
+void difference_scalar(const double *x, double *y, int n, int s, double d2, double e)
+{
+	for (int i = 0; i < n; ++i)
+		y[i] = -(x[i + s] - x[i - s])/d2 + e;
+}
+
+/* 1/A of Nanbu's model for 0.1 <= s < 3 */
+double nanbu_A_inv(double s)
+{
+	return 0.0056958 + s*(0.9560202 + s*(-0.508139 + s*(0.47913906
+			+ s*(-0.12788975 + s*0.02389567))));
+}
+
+/* cos_xi at A of Nanbu's model, for A -> 0 it is isotropic */
+double nanbu_cos_xi(double A, double u)
+{
+	return A > 0 ? 1 + log(u + (1 - u)*exp(-2*A))/A : 2*u - 1;
+}
+
+void coulomb_scalar(const CoulombKernelArgs &a, int n)
+{
+	const double r1 = a.m2/(a.m1 + a.m2);
+	const double r2 = a.m1/(a.m1 + a.m2);
+
+	for (int i = 0; i < n; ++i) {
+		double g[3] = {a.v1[0][i] - a.v2[0][i], a.v1[1][i] - a.v2[1][i],
+			a.v1[2][i] - a.v2[2][i]};
+		double g_perp2 = g[1]*g[1] + g[2]*g[2];
+		double g2 = g[0]*g[0] + g_perp2;
+		double g_mag = sqrt(g2);
+		double g_perp = sqrt(g_perp2);
+
+		double s = a.s_factor/(g2*g_mag);
+		double cos_xi = a.table ? coulomb_cos_xi(*a.table, s, a.u_xi[i])
+			: coulomb_cos_xi(s, a.u_xi[i]);
+		double sin_xi = sqrt(1 - cos_xi*cos_xi);
+
+		double eps = 2*Const::PI*a.u_eps[i];
+		double cos_eps = cos(eps);
+		double sin_eps = sin(eps);
+		double h[3] = {
+			g_perp*cos_eps,
+			-(g[1]*g[0]*cos_eps + g_mag*g[2]*sin_eps)/g_perp,
+			-(g[2]*g[0]*cos_eps - g_mag*g[1]*sin_eps)/g_perp
+		};
+
+		for (int d = 0; d < 3; ++d) {
+			double dv = g[d]*(1 - cos_xi) + h[d]*sin_xi;
+			a.v1[d][i] -= r1*dv;
+			a.v2[d][i] += r2*dv;
+		}
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2,fma")))
+int push_avx2(const PushKernelArgs &a, int begin, int end, int *slow)
+{
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d q_m = _mm256_set1_pd(a.q/a.m);
+	const __m256d time_step = _mm256_set1_pd(a.time_step);
+
+	int n_slow = 0, p = begin;
+	for (; p + 4 <= end; p += 4) {
+		__m256d dt = _mm256_loadu_pd(a.dt + p);
+		__m256d alive = _mm256_cmp_pd(_mm256_loadu_pd(a.w_mp + p), zero, _CMP_GT_OQ);
+
+		__m256d x[3], v[3], w[3][2];
+		__m128i c[3];
+		for (int dim = 0; dim < 3; ++dim) {
+			x[dim] = _mm256_loadu_pd(a.x[dim] + p);
+			v[dim] = _mm256_loadu_pd(a.v[dim] + p);
+
+			__m256d l = _mm256_mul_pd(_mm256_sub_pd(x[dim],
+						_mm256_set1_pd(a.x_min[dim])), _mm256_set1_pd(1/a.del_x[dim]));
+			c[dim] = _mm_min_epi32(_mm256_cvttpd_epi32(l), _mm_set1_epi32(a.c_max[dim]));
+			c[dim] = _mm_max_epi32(c[dim], _mm_setzero_si128());
+
+			__m256d d = _mm256_sub_pd(l, _mm256_cvtepi32_pd(c[dim]));
+			w[dim][0] = _mm256_sub_pd(one, d);
+			w[dim][1] = d;
+		}
+
+		__m128i u = _mm_add_epi32(_mm_mullo_epi32(c[0], _mm_set1_epi32(a.E_stride[0])),
+				_mm_add_epi32(_mm_mullo_epi32(c[1], _mm_set1_epi32(a.E_stride[1])),
+					_mm_mullo_epi32(c[2], _mm_set1_epi32(a.E_stride[2]))));
+
+		/* trilinear gather, dead particles are masked out since their
+		 * position may lie anywhere */
+		__m256d E[3] = {zero, zero, zero};
+		for (int corner = 0; corner < 8; ++corner) {
+			__m256d weight = _mm256_mul_pd(_mm256_mul_pd(w[0][corner & 1],
+						w[1][(corner >> 1) & 1]), w[2][corner >> 2]);
+			__m128i index = _mm_add_epi32(u, _mm_set1_epi32(a.E_corner[corner]));
+			for (int dim = 0; dim < 3; ++dim) {
+				__m256d f = _mm256_mask_i32gather_pd(zero, a.E + dim*a.E_comp_stride,
+						index, alive, 8);
+				E[dim] = _mm256_fmadd_pd(f, weight, E[dim]);
+			}
+		}
+
+		/* kick and drift */
+		__m256d dt_qm = _mm256_mul_pd(dt, q_m);
+		__m256d inside = _mm256_and_pd(alive, _mm256_cmp_pd(dt, zero, _CMP_GT_OQ));
+		for (int dim = 0; dim < 3; ++dim) {
+			v[dim] = _mm256_fmadd_pd(E[dim], dt_qm, v[dim]);
+			x[dim] = _mm256_fmadd_pd(v[dim], dt, x[dim]);
+			inside = _mm256_and_pd(inside, _mm256_cmp_pd(
+						_mm256_set1_pd(a.x_min[dim]), x[dim], _CMP_LT_OQ));
+			inside = _mm256_and_pd(inside, _mm256_cmp_pd(
+						x[dim], _mm256_set1_pd(a.x_max[dim]), _CMP_LT_OQ));
+		}
+
+		__m256i store = _mm256_castpd_si256(inside);
+		for (int dim = 0; dim < 3; ++dim) {
+			_mm256_maskstore_pd(a.x[dim] + p, store, x[dim]);
+			_mm256_maskstore_pd(a.v[dim] + p, store, v[dim]);
+		}
+		_mm256_maskstore_pd(a.dt + p, store, time_step);
+
+		int mask = _mm256_movemask_pd(inside);
+		for (int lane = 0; lane < 4; ++lane) {
+			if (!(mask & (1 << lane)))
+				slow[n_slow++] = p + lane;
+		}
+	}
+
+	for (; p < end; ++p)
+		slow[n_slow++] = p;
+
+	return n_slow;
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+int push_avx512(const PushKernelArgs &a, int begin, int end, int *slow)
+{
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d q_m = _mm512_set1_pd(a.q/a.m);
+	const __m512d time_step = _mm512_set1_pd(a.time_step);
+
+	int n_slow = 0, p = begin;
+	for (; p + 8 <= end; p += 8) {
+		__m512d dt = _mm512_loadu_pd(a.dt + p);
+		__mmask8 alive = _mm512_cmp_pd_mask(_mm512_loadu_pd(a.w_mp + p), zero, _CMP_GT_OQ);
+
+		__m512d x[3], v[3], w[3][2];
+		__m256i c[3];
+		for (int dim = 0; dim < 3; ++dim) {
+			x[dim] = _mm512_loadu_pd(a.x[dim] + p);
+			v[dim] = _mm512_loadu_pd(a.v[dim] + p);
+
+			__m512d l = _mm512_mul_pd(_mm512_sub_pd(x[dim],
+						_mm512_set1_pd(a.x_min[dim])), _mm512_set1_pd(1/a.del_x[dim]));
+			c[dim] = _mm256_min_epi32(_mm512_cvttpd_epi32(l), _mm256_set1_epi32(a.c_max[dim]));
+			c[dim] = _mm256_max_epi32(c[dim], _mm256_setzero_si256());
+
+			__m512d d = _mm512_sub_pd(l, _mm512_cvtepi32_pd(c[dim]));
+			w[dim][0] = _mm512_sub_pd(one, d);
+			w[dim][1] = d;
+		}
+
+		__m256i u = _mm256_add_epi32(_mm256_mullo_epi32(c[0], _mm256_set1_epi32(a.E_stride[0])),
+				_mm256_add_epi32(_mm256_mullo_epi32(c[1], _mm256_set1_epi32(a.E_stride[1])),
+					_mm256_mullo_epi32(c[2], _mm256_set1_epi32(a.E_stride[2]))));
+
+		/* trilinear gather, dead particles are masked out since their
+		 * position may lie anywhere */
+		__m512d E[3] = {zero, zero, zero};
+		for (int corner = 0; corner < 8; ++corner) {
+			__m512d weight = _mm512_mul_pd(_mm512_mul_pd(w[0][corner & 1],
+						w[1][(corner >> 1) & 1]), w[2][corner >> 2]);
+			__m256i index = _mm256_add_epi32(u, _mm256_set1_epi32(a.E_corner[corner]));
+			for (int dim = 0; dim < 3; ++dim) {
+				__m512d f = _mm512_mask_i32gather_pd(zero, alive, index,
+						a.E + dim*a.E_comp_stride, 8);
+				E[dim] = _mm512_fmadd_pd(f, weight, E[dim]);
+			}
+		}
+
+		/* kick and drift */
+		__m512d dt_qm = _mm512_mul_pd(dt, q_m);
+		__mmask8 inside = alive & _mm512_cmp_pd_mask(dt, zero, _CMP_GT_OQ);
+		for (int dim = 0; dim < 3; ++dim) {
+			v[dim] = _mm512_fmadd_pd(E[dim], dt_qm, v[dim]);
+			x[dim] = _mm512_fmadd_pd(v[dim], dt, x[dim]);
+			inside &= _mm512_cmp_pd_mask(_mm512_set1_pd(a.x_min[dim]), x[dim], _CMP_LT_OQ);
+			inside &= _mm512_cmp_pd_mask(x[dim], _mm512_set1_pd(a.x_max[dim]), _CMP_LT_OQ);
+		}
+
+		for (int dim = 0; dim < 3; ++dim) {
+			_mm512_mask_storeu_pd(a.x[dim] + p, inside, x[dim]);
+			_mm512_mask_storeu_pd(a.v[dim] + p, inside, v[dim]);
+		}
+		_mm512_mask_storeu_pd(a.dt + p, inside, time_step);
+
+		for (int lane = 0; lane < 8; ++lane) {
+			if (!(inside & (1 << lane)))
+				slow[n_slow++] = p + lane;
+		}
+	}
+
+	for (; p < end; ++p)
+		slow[n_slow++] = p;
+
+	return n_slow;
+}
+
+__attribute__((target("avx2,fma")))
+void stencil_avx2(const double *x, double *y, int n, int sj, int sk,
+		const double *c)
+{
+	const __m256d c0 = _mm256_set1_pd(c[0]);
+	const __m256d c1 = _mm256_set1_pd(c[1]);
+	const __m256d c2 = _mm256_set1_pd(c[2]);
+	const __m256d c3 = _mm256_set1_pd(c[3]);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const double *xi = x + i;
+		__m256d f = _mm256_mul_pd(c0, _mm256_loadu_pd(xi));
+		f = _mm256_fmadd_pd(c1, _mm256_add_pd(_mm256_loadu_pd(xi - 1),
+					_mm256_loadu_pd(xi + 1)), f);
+		f = _mm256_fmadd_pd(c2, _mm256_add_pd(_mm256_loadu_pd(xi - sj),
+					_mm256_loadu_pd(xi + sj)), f);
+		f = _mm256_fmadd_pd(c3, _mm256_add_pd(_mm256_loadu_pd(xi - sk),
+					_mm256_loadu_pd(xi + sk)), f);
+		_mm256_storeu_pd(y + i, f);
+	}
+
+	stencil_scalar(x + i, y + i, n - i, sj, sk, c);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+void stencil_avx512(const double *x, double *y, int n, int sj, int sk,
+		const double *c)
+{
+	const __m512d c0 = _mm512_set1_pd(c[0]);
+	const __m512d c1 = _mm512_set1_pd(c[1]);
+	const __m512d c2 = _mm512_set1_pd(c[2]);
+	const __m512d c3 = _mm512_set1_pd(c[3]);
+
+	for (int i = 0; i < n; i += 8) {
+		/* the tail is masked */
+		__mmask8 m = n - i >= 8 ? 0xff : (1 << (n - i)) - 1;
+		const double *xi = x + i;
+		__m512d f = _mm512_mul_pd(c0, _mm512_maskz_loadu_pd(m, xi));
+		f = _mm512_fmadd_pd(c1, _mm512_add_pd(_mm512_maskz_loadu_pd(m, xi - 1),
+					_mm512_maskz_loadu_pd(m, xi + 1)), f);
+		f = _mm512_fmadd_pd(c2, _mm512_add_pd(_mm512_maskz_loadu_pd(m, xi - sj),
+					_mm512_maskz_loadu_pd(m, xi + sj)), f);
+		f = _mm512_fmadd_pd(c3, _mm512_add_pd(_mm512_maskz_loadu_pd(m, xi - sk),
+					_mm512_maskz_loadu_pd(m, xi + sk)), f);
+		_mm512_mask_storeu_pd(y + i, m, f);
+	}
+}
+
+/* the sign is flipped, not subtracted from zero, so that the result is
+ * bitwise the one of the scalar loop */
+__attribute__((target("avx2,fma")))
+void difference_avx2(const double *x, double *y, int n, int s, double d2, double e)
+{
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	const __m256d d2_v = _mm256_set1_pd(d2);
+	const __m256d e_v = _mm256_set1_pd(e);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d f = _mm256_sub_pd(_mm256_loadu_pd(x + i + s), _mm256_loadu_pd(x + i - s));
+		f = _mm256_div_pd(_mm256_xor_pd(f, sign), d2_v);
+		_mm256_storeu_pd(y + i, _mm256_add_pd(f, e_v));
+	}
+
+	difference_scalar(x + i, y + i, n - i, s, d2, e);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+void difference_avx512(const double *x, double *y, int n, int s, double d2, double e)
+{
+	const __m512d sign = _mm512_set1_pd(-0.0);
+	const __m512d d2_v = _mm512_set1_pd(d2);
+	const __m512d e_v = _mm512_set1_pd(e);
+
+	for (int i = 0; i < n; i += 8) {
+		/* the tail is masked */
+		__mmask8 m = n - i >= 8 ? 0xff : (1 << (n - i)) - 1;
+		__m512d f = _mm512_sub_pd(_mm512_maskz_loadu_pd(m, x + i + s),
+				_mm512_maskz_loadu_pd(m, x + i - s));
+		f = _mm512_div_pd(_mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(f),
+						_mm512_castpd_si512(sign))), d2_v);
+		_mm512_mask_storeu_pd(y + i, m, _mm512_add_pd(f, e_v));
+	}
+}
+
+/* exp, log and the sine and cosine of 2*pi*u of the Cephes library for the
+ * Coulomb kernels, with relative errors of a few 1e-16 on the ranges used
+ * there, exp clamps its argument to [-708, 708] */
+__attribute__((target("avx2,fma")))
+__m256d exp_avx2(__m256d x)
+{
+	x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(708.0)), _mm256_set1_pd(-708.0));
+
+	/* x = n*ln(2) + r with |r| <= ln(2)/2 */
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	x = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93145751953125e-1), x);
+	x = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.42860682030941723212e-6), x);
+
+	/* Pade approximation of exp(r) */
+	__m256d xx = _mm256_mul_pd(x, x);
+	__m256d p = _mm256_fmadd_pd(_mm256_set1_pd(1.26177193074810590878e-4), xx,
+			_mm256_set1_pd(3.02994407707441961300e-2));
+	p = _mm256_mul_pd(x, _mm256_fmadd_pd(p, xx, _mm256_set1_pd(9.99999999999999999910e-1)));
+	__m256d q = _mm256_fmadd_pd(_mm256_set1_pd(3.00198505138664455042e-6), xx,
+			_mm256_set1_pd(2.52448340349684104192e-3));
+	q = _mm256_fmadd_pd(q, xx, _mm256_set1_pd(2.27265548208155028766e-1));
+	q = _mm256_fmadd_pd(q, xx, _mm256_set1_pd(2.00000000000000000009e0));
+	x = _mm256_div_pd(p, _mm256_sub_pd(q, p));
+	x = _mm256_fmadd_pd(_mm256_set1_pd(2.0), x, _mm256_set1_pd(1.0));
+
+	/* times 2^n, built in the exponent bits */
+	__m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+	e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+	return _mm256_mul_pd(x, _mm256_castsi256_pd(e));
+}
+
+/* for x > 0 and x == 0 */
+__attribute__((target("avx2,fma")))
+__m256d log_avx2(__m256d x)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+	__m256i bits = _mm256_castpd_si256(x);
+
+	/* x = m*2^e with m in [0.5, 1), the exponent is converted to a double
+	 * in the mantissa of 2^52 */
+	__m256d e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52),
+				_mm256_castpd_si256(_mm256_set1_pd(0x1p52))));
+	e = _mm256_sub_pd(e, _mm256_set1_pd(0x1p52 + 1022));
+	__m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+				_mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffff)),
+				_mm256_set1_epi64x(0x3fe0000000000000)));
+
+	/* m in [sqrt(0.5), sqrt(2)) */
+	__m256d small = _mm256_cmp_pd(m, _mm256_set1_pd(0.70710678118654752440), _CMP_LT_OQ);
+	e = _mm256_sub_pd(e, _mm256_and_pd(small, one));
+	m = _mm256_sub_pd(_mm256_add_pd(m, _mm256_and_pd(small, m)), one);
+
+	/* rational approximation of log(1 + m) */
+	__m256d z = _mm256_mul_pd(m, m);
+	__m256d p = _mm256_fmadd_pd(_mm256_set1_pd(1.01875663804580931796e-4), m,
+			_mm256_set1_pd(4.97494994976747001425e-1));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(4.70579119878881725854e0));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(1.44989225341610930846e1));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(1.79368678507819816313e1));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(7.70838733755885391666e0));
+	__m256d q = _mm256_add_pd(m, _mm256_set1_pd(1.12873587189167450590e1));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(4.52279145837532221105e1));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(8.29875266912776603211e1));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(7.11544750618563894466e1));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(2.31251620126765340583e1));
+	__m256d y = _mm256_mul_pd(m, _mm256_div_pd(_mm256_mul_pd(z, p), q));
+
+	/* plus e*ln(2) in two parts */
+	y = _mm256_fmadd_pd(e, _mm256_set1_pd(-2.121944400546905827679e-4), y);
+	y = _mm256_fnmadd_pd(_mm256_set1_pd(0.5), z, y);
+	y = _mm256_fmadd_pd(e, _mm256_set1_pd(0.693359375), _mm256_add_pd(m, y));
+
+	return _mm256_blendv_pd(y, _mm256_set1_pd(-HUGE_VAL),
+			_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_EQ_OQ));
+}
+
+/* sine and cosine of 2*pi*u for u in [0, 1) */
+__attribute__((target("avx2,fma")))
+void sincos_2pi_avx2(__m256d u, __m256d &sin_x, __m256d &cos_x)
+{
+	/* 2*pi*u = q*pi/2 + r with |r| <= pi/4, u - q/4 is exact */
+	__m256d q = _mm256_round_pd(_mm256_mul_pd(u, _mm256_set1_pd(4.0)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_mul_pd(_mm256_fnmadd_pd(q, _mm256_set1_pd(0.25), u),
+			_mm256_set1_pd(2*Const::PI));
+	__m256d z = _mm256_mul_pd(r, r);
+
+	__m256d s = _mm256_fmadd_pd(_mm256_set1_pd(1.58962301576546568060e-10), z,
+			_mm256_set1_pd(-2.50507477628578072866e-8));
+	s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(2.75573136213857245213e-6));
+	s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(-1.98412698295895385996e-4));
+	s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(8.33333333332211858878e-3));
+	s = _mm256_fmadd_pd(s, z, _mm256_set1_pd(-1.66666666666666307295e-1));
+	s = _mm256_fmadd_pd(_mm256_mul_pd(r, z), s, r);
+
+	__m256d c = _mm256_fmadd_pd(_mm256_set1_pd(-1.13585365213876817300e-11), z,
+			_mm256_set1_pd(2.08757008419747316778e-9));
+	c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(-2.75573141792967388112e-7));
+	c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(2.48015872888517045348e-5));
+	c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(-1.38888888888730564116e-3));
+	c = _mm256_fmadd_pd(c, z, _mm256_set1_pd(4.16666666666665929218e-2));
+	c = _mm256_fmadd_pd(_mm256_mul_pd(z, z), c,
+			_mm256_fnmadd_pd(_mm256_set1_pd(0.5), z, _mm256_set1_pd(1.0)));
+
+	/* quadrant q: odd ones swap sine and cosine, the sine is negative in
+	 * 2 and 3, the cosine in 1 and 2 */
+	__m256i qi = _mm256_castpd_si256(_mm256_add_pd(q, _mm256_set1_pd(0x1p52)));
+	__m256d swap = _mm256_castsi256_pd(_mm256_slli_epi64(qi, 63));
+	__m256i two = _mm256_set1_epi64x(2);
+	__m256d sin_sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi, two), 62));
+	__m256d cos_sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(
+					_mm256_add_epi64(qi, _mm256_set1_epi64x(1)), two), 62));
+
+	sin_x = _mm256_xor_pd(_mm256_blendv_pd(s, c, swap), sin_sign);
+	cos_x = _mm256_xor_pd(_mm256_blendv_pd(c, s, swap), cos_sign);
+}
+
+/* the branches of coulomb_cos_xi are blended, s < 0.1 is the middle branch
+ * with A_inv = s and exp(-2*A) = 0 */
+__attribute__((target("avx2,fma")))
+__m256d coulomb_cos_xi_avx2(__m256d s, __m256d u)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+
+	/* A of 0.1 <= s < 3 and of 3 <= s < 6 */
+	__m256d A_inv_3 = _mm256_fmadd_pd(_mm256_set1_pd(0.02389567), s,
+			_mm256_set1_pd(-0.12788975));
+	A_inv_3 = _mm256_fmadd_pd(A_inv_3, s, _mm256_set1_pd(0.47913906));
+	A_inv_3 = _mm256_fmadd_pd(A_inv_3, s, _mm256_set1_pd(-0.508139));
+	A_inv_3 = _mm256_fmadd_pd(A_inv_3, s, _mm256_set1_pd(0.9560202));
+	A_inv_3 = _mm256_fmadd_pd(A_inv_3, s, _mm256_set1_pd(0.0056958));
+	__m256d A_6 = _mm256_mul_pd(_mm256_set1_pd(3.0),
+			exp_avx2(_mm256_sub_pd(_mm256_setzero_pd(), s)));
+
+	__m256d below_3 = _mm256_cmp_pd(s, _mm256_set1_pd(3.0), _CMP_LT_OQ);
+	__m256d below_01 = _mm256_cmp_pd(s, _mm256_set1_pd(0.1), _CMP_LT_OQ);
+	__m256d A = _mm256_blendv_pd(A_6, _mm256_div_pd(one, A_inv_3), below_3);
+	__m256d A_inv = _mm256_blendv_pd(_mm256_div_pd(one, A_6), A_inv_3, below_3);
+	A_inv = _mm256_blendv_pd(A_inv, s, below_01);
+	__m256d t = _mm256_andnot_pd(below_01,
+			exp_avx2(_mm256_mul_pd(_mm256_set1_pd(-2.0), A)));
+
+	__m256d cos_xi = _mm256_fmadd_pd(A_inv,
+			log_avx2(_mm256_fmadd_pd(_mm256_sub_pd(one, u), t, u)), one);
+	return _mm256_blendv_pd(_mm256_fmsub_pd(_mm256_set1_pd(2.0), u, one), cos_xi,
+			_mm256_cmp_pd(s, _mm256_set1_pd(6.0), _CMP_LT_OQ));
+}
+
+/* the table needs no exp, only lanes of the middle branch below the table
+ * are sampled from the analytic form */
+__attribute__((target("avx2,fma")))
+__m256d coulomb_table_cos_xi_avx2(const CoulombTable &t, __m256d s, __m256d u)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+	__m256d below_3 = _mm256_cmp_pd(s, _mm256_set1_pd(3.0), _CMP_LT_OQ);
+	__m256d middle = _mm256_and_pd(_mm256_cmp_pd(s, _mm256_set1_pd(0.1), _CMP_GE_OQ),
+			_mm256_cmp_pd(s, _mm256_set1_pd(6.0), _CMP_LT_OQ));
+	__m256d in = _mm256_and_pd(middle, _mm256_cmp_pd(u,
+				_mm256_set1_pd(ldexp(1.0, -t.binades)), _CMP_GE_OQ));
+
+	/* row coordinate, zero outside of the table */
+	__m256d A_inv = _mm256_fmadd_pd(_mm256_set1_pd(0.02389567), s,
+			_mm256_set1_pd(-0.12788975));
+	A_inv = _mm256_fmadd_pd(A_inv, s, _mm256_set1_pd(0.47913906));
+	A_inv = _mm256_fmadd_pd(A_inv, s, _mm256_set1_pd(-0.508139));
+	A_inv = _mm256_fmadd_pd(A_inv, s, _mm256_set1_pd(0.9560202));
+	A_inv = _mm256_fmadd_pd(A_inv, s, _mm256_set1_pd(0.0056958));
+	__m256d x_A = _mm256_div_pd(_mm256_sub_pd(_mm256_div_pd(one, A_inv),
+				_mm256_set1_pd(t.A_min)), _mm256_set1_pd(t.del_A));
+	__m256d x_s = _mm256_add_pd(_mm256_set1_pd(t.rows_A), _mm256_div_pd(
+				_mm256_sub_pd(s, _mm256_set1_pd(3.0)), _mm256_set1_pd(t.del_s)));
+	__m256d x = _mm256_and_pd(in, _mm256_blendv_pd(x_s, x_A, below_3));
+	__m256d x_min = _mm256_blendv_pd(_mm256_set1_pd(t.rows_A), _mm256_setzero_pd(), below_3);
+	__m256d x_max = _mm256_blendv_pd(_mm256_set1_pd(t.rows_A + t.rows_s - 2),
+			_mm256_set1_pd(t.rows_A - 2), below_3);
+	__m256d x_i = _mm256_min_pd(_mm256_max_pd(_mm256_floor_pd(x), x_min), x_max);
+
+	/* column coordinate, u = (1 + f)*2^(e - 1023) with f in [0, 1) */
+	__m256i bits = _mm256_castpd_si256(u);
+	__m256d e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52),
+				_mm256_castpd_si256(_mm256_set1_pd(0x1p52))));
+	e = _mm256_sub_pd(e, _mm256_set1_pd(0x1p52 + 1023 - t.binades));
+	__m256d f = _mm256_castsi256_pd(_mm256_or_si256(
+				_mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffff)),
+				_mm256_castpd_si256(one)));
+	__m256d y = _mm256_and_pd(in, _mm256_mul_pd(_mm256_add_pd(e, _mm256_sub_pd(f, one)),
+				_mm256_set1_pd(t.per_binade)));
+	__m256d y_j = _mm256_min_pd(_mm256_floor_pd(y), _mm256_set1_pd(t.n_cols - 2));
+
+	/* bilinear interpolation */
+	const float *c = t.data.data();
+	__m128i k = _mm256_cvtpd_epi32(_mm256_fmadd_pd(x_i, _mm256_set1_pd(t.n_cols), y_j));
+	__m256d c00 = _mm256_cvtps_pd(_mm_i32gather_ps(c, k, 4));
+	__m256d c01 = _mm256_cvtps_pd(_mm_i32gather_ps(c + 1, k, 4));
+	__m256d c10 = _mm256_cvtps_pd(_mm_i32gather_ps(c + t.n_cols, k, 4));
+	__m256d c11 = _mm256_cvtps_pd(_mm_i32gather_ps(c + t.n_cols + 1, k, 4));
+	__m256d t_y = _mm256_sub_pd(y, y_j);
+	__m256d c0 = _mm256_fmadd_pd(t_y, _mm256_sub_pd(c01, c00), c00);
+	__m256d c1 = _mm256_fmadd_pd(t_y, _mm256_sub_pd(c11, c10), c10);
+	__m256d cos_xi = _mm256_fmadd_pd(_mm256_sub_pd(x, x_i), _mm256_sub_pd(c1, c0), c0);
+
+	/* the small angle and the isotropic branch */
+	__m256d below_01 = _mm256_cmp_pd(s, _mm256_set1_pd(0.1), _CMP_LT_OQ);
+	if (_mm256_movemask_pd(below_01))
+		cos_xi = _mm256_blendv_pd(cos_xi, _mm256_fmadd_pd(s, log_avx2(u), one), below_01);
+	cos_xi = _mm256_blendv_pd(cos_xi, _mm256_fmsub_pd(_mm256_set1_pd(2.0), u, one),
+			_mm256_cmp_pd(s, _mm256_set1_pd(6.0), _CMP_NLT_UQ));
+
+	__m256d rest = _mm256_andnot_pd(in, middle);
+	if (_mm256_movemask_pd(rest))
+		cos_xi = _mm256_blendv_pd(cos_xi, coulomb_cos_xi_avx2(s, u), rest);
+
+	return cos_xi;
+}
+
+__attribute__((target("avx2,fma")))
+void coulomb_avx2(const CoulombKernelArgs &a, int n)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d r1 = _mm256_set1_pd(a.m2/(a.m1 + a.m2));
+	const __m256d r2 = _mm256_set1_pd(a.m1/(a.m1 + a.m2));
+	const __m256d s_factor = _mm256_set1_pd(a.s_factor);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d v1[3], v2[3], g[3];
+		for (int d = 0; d < 3; ++d) {
+			v1[d] = _mm256_loadu_pd(a.v1[d] + i);
+			v2[d] = _mm256_loadu_pd(a.v2[d] + i);
+			g[d] = _mm256_sub_pd(v1[d], v2[d]);
+		}
+
+		__m256d g_perp2 = _mm256_fmadd_pd(g[1], g[1], _mm256_mul_pd(g[2], g[2]));
+		__m256d g2 = _mm256_fmadd_pd(g[0], g[0], g_perp2);
+		__m256d g_mag = _mm256_sqrt_pd(g2);
+		__m256d g_perp = _mm256_sqrt_pd(g_perp2);
+		__m256d s = _mm256_div_pd(s_factor, _mm256_mul_pd(g2, g_mag));
+
+		__m256d u = _mm256_loadu_pd(a.u_xi + i);
+		__m256d cos_xi = a.table ? coulomb_table_cos_xi_avx2(*a.table, s, u)
+			: coulomb_cos_xi_avx2(s, u);
+		cos_xi = _mm256_min_pd(_mm256_max_pd(cos_xi, _mm256_set1_pd(-1.0)), one);
+		__m256d sin_xi = _mm256_sqrt_pd(_mm256_fnmadd_pd(cos_xi, cos_xi, one));
+
+		__m256d sin_eps, cos_eps;
+		sincos_2pi_avx2(_mm256_loadu_pd(a.u_eps + i), sin_eps, cos_eps);
+
+		__m256d h[3];
+		h[0] = _mm256_mul_pd(g_perp, cos_eps);
+		h[1] = _mm256_fmadd_pd(_mm256_mul_pd(g[1], g[0]), cos_eps,
+				_mm256_mul_pd(_mm256_mul_pd(g_mag, g[2]), sin_eps));
+		h[1] = _mm256_div_pd(_mm256_sub_pd(_mm256_setzero_pd(), h[1]), g_perp);
+		h[2] = _mm256_fmsub_pd(_mm256_mul_pd(g[2], g[0]), cos_eps,
+				_mm256_mul_pd(_mm256_mul_pd(g_mag, g[1]), sin_eps));
+		h[2] = _mm256_div_pd(_mm256_sub_pd(_mm256_setzero_pd(), h[2]), g_perp);
+
+		__m256d one_cos = _mm256_sub_pd(one, cos_xi);
+		for (int d = 0; d < 3; ++d) {
+			__m256d dv = _mm256_fmadd_pd(g[d], one_cos, _mm256_mul_pd(h[d], sin_xi));
+			_mm256_storeu_pd(a.v1[d] + i, _mm256_fnmadd_pd(r1, dv, v1[d]));
+			_mm256_storeu_pd(a.v2[d] + i, _mm256_fmadd_pd(r2, dv, v2[d]));
+		}
+	}
+
+	CoulombKernelArgs tail = a;
+	for (int d = 0; d < 3; ++d) {
+		tail.v1[d] += i;
+		tail.v2[d] += i;
+	}
+	tail.u_xi += i;
+	tail.u_eps += i;
+	coulomb_scalar(tail, n - i);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+__m512d exp_avx512(__m512d x)
+{
+	x = _mm512_max_pd(_mm512_min_pd(x, _mm512_set1_pd(708.0)), _mm512_set1_pd(-708.0));
+
+	__m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	x = _mm512_fnmadd_pd(n, _mm512_set1_pd(6.93145751953125e-1), x);
+	x = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.42860682030941723212e-6), x);
+
+	__m512d xx = _mm512_mul_pd(x, x);
+	__m512d p = _mm512_fmadd_pd(_mm512_set1_pd(1.26177193074810590878e-4), xx,
+			_mm512_set1_pd(3.02994407707441961300e-2));
+	p = _mm512_mul_pd(x, _mm512_fmadd_pd(p, xx, _mm512_set1_pd(9.99999999999999999910e-1)));
+	__m512d q = _mm512_fmadd_pd(_mm512_set1_pd(3.00198505138664455042e-6), xx,
+			_mm512_set1_pd(2.52448340349684104192e-3));
+	q = _mm512_fmadd_pd(q, xx, _mm512_set1_pd(2.27265548208155028766e-1));
+	q = _mm512_fmadd_pd(q, xx, _mm512_set1_pd(2.00000000000000000009e0));
+	x = _mm512_div_pd(p, _mm512_sub_pd(q, p));
+	x = _mm512_fmadd_pd(_mm512_set1_pd(2.0), x, _mm512_set1_pd(1.0));
+
+	return _mm512_scalef_pd(x, n);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+__m512d log_avx512(__m512d x)
+{
+	const __m512d one = _mm512_set1_pd(1.0);
+
+	/* x = m*2^e with m in [0.5, 1) */
+	__m512d e = _mm512_add_pd(_mm512_getexp_pd(x), one);
+	__m512d m = _mm512_getmant_pd(x, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_src);
+
+	__mmask8 small = _mm512_cmp_pd_mask(m, _mm512_set1_pd(0.70710678118654752440), _CMP_LT_OQ);
+	e = _mm512_mask_sub_pd(e, small, e, one);
+	m = _mm512_sub_pd(_mm512_mask_add_pd(m, small, m, m), one);
+
+	__m512d z = _mm512_mul_pd(m, m);
+	__m512d p = _mm512_fmadd_pd(_mm512_set1_pd(1.01875663804580931796e-4), m,
+			_mm512_set1_pd(4.97494994976747001425e-1));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(4.70579119878881725854e0));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(1.44989225341610930846e1));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(1.79368678507819816313e1));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(7.70838733755885391666e0));
+	__m512d q = _mm512_add_pd(m, _mm512_set1_pd(1.12873587189167450590e1));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(4.52279145837532221105e1));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(8.29875266912776603211e1));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(7.11544750618563894466e1));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(2.31251620126765340583e1));
+	__m512d y = _mm512_mul_pd(m, _mm512_div_pd(_mm512_mul_pd(z, p), q));
+
+	y = _mm512_fmadd_pd(e, _mm512_set1_pd(-2.121944400546905827679e-4), y);
+	y = _mm512_fnmadd_pd(_mm512_set1_pd(0.5), z, y);
+	y = _mm512_fmadd_pd(e, _mm512_set1_pd(0.693359375), _mm512_add_pd(m, y));
+
+	return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_EQ_OQ),
+			y, _mm512_set1_pd(-HUGE_VAL));
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+void sincos_2pi_avx512(__m512d u, __m512d &sin_x, __m512d &cos_x)
+{
+	__m512d q = _mm512_roundscale_pd(_mm512_mul_pd(u, _mm512_set1_pd(4.0)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d r = _mm512_mul_pd(_mm512_fnmadd_pd(q, _mm512_set1_pd(0.25), u),
+			_mm512_set1_pd(2*Const::PI));
+	__m512d z = _mm512_mul_pd(r, r);
+
+	__m512d s = _mm512_fmadd_pd(_mm512_set1_pd(1.58962301576546568060e-10), z,
+			_mm512_set1_pd(-2.50507477628578072866e-8));
+	s = _mm512_fmadd_pd(s, z, _mm512_set1_pd(2.75573136213857245213e-6));
+	s = _mm512_fmadd_pd(s, z, _mm512_set1_pd(-1.98412698295895385996e-4));
+	s = _mm512_fmadd_pd(s, z, _mm512_set1_pd(8.33333333332211858878e-3));
+	s = _mm512_fmadd_pd(s, z, _mm512_set1_pd(-1.66666666666666307295e-1));
+	s = _mm512_fmadd_pd(_mm512_mul_pd(r, z), s, r);
+
+	__m512d c = _mm512_fmadd_pd(_mm512_set1_pd(-1.13585365213876817300e-11), z,
+			_mm512_set1_pd(2.08757008419747316778e-9));
+	c = _mm512_fmadd_pd(c, z, _mm512_set1_pd(-2.75573141792967388112e-7));
+	c = _mm512_fmadd_pd(c, z, _mm512_set1_pd(2.48015872888517045348e-5));
+	c = _mm512_fmadd_pd(c, z, _mm512_set1_pd(-1.38888888888730564116e-3));
+	c = _mm512_fmadd_pd(c, z, _mm512_set1_pd(4.16666666666665929218e-2));
+	c = _mm512_fmadd_pd(_mm512_mul_pd(z, z), c,
+			_mm512_fnmadd_pd(_mm512_set1_pd(0.5), z, _mm512_set1_pd(1.0)));
+
+	__m512i qi = _mm512_castpd_si512(_mm512_add_pd(q, _mm512_set1_pd(0x1p52)));
+	__mmask8 swap = _mm512_test_epi64_mask(qi, _mm512_set1_epi64(1));
+	__m512i two = _mm512_set1_epi64(2);
+	__m512i sin_sign = _mm512_slli_epi64(_mm512_and_si512(qi, two), 62);
+	__m512i cos_sign = _mm512_slli_epi64(_mm512_and_si512(
+				_mm512_add_epi64(qi, _mm512_set1_epi64(1)), two), 62);
+
+	sin_x = _mm512_castsi512_pd(_mm512_xor_si512(
+				_mm512_castpd_si512(_mm512_mask_blend_pd(swap, s, c)), sin_sign));
+	cos_x = _mm512_castsi512_pd(_mm512_xor_si512(
+				_mm512_castpd_si512(_mm512_mask_blend_pd(swap, c, s)), cos_sign));
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+__m512d coulomb_cos_xi_avx512(__m512d s, __m512d u)
+{
+	const __m512d one = _mm512_set1_pd(1.0);
+
+	__m512d A_inv_3 = _mm512_fmadd_pd(_mm512_set1_pd(0.02389567), s,
+			_mm512_set1_pd(-0.12788975));
+	A_inv_3 = _mm512_fmadd_pd(A_inv_3, s, _mm512_set1_pd(0.47913906));
+	A_inv_3 = _mm512_fmadd_pd(A_inv_3, s, _mm512_set1_pd(-0.508139));
+	A_inv_3 = _mm512_fmadd_pd(A_inv_3, s, _mm512_set1_pd(0.9560202));
+	A_inv_3 = _mm512_fmadd_pd(A_inv_3, s, _mm512_set1_pd(0.0056958));
+	__m512d A_6 = _mm512_mul_pd(_mm512_set1_pd(3.0),
+			exp_avx512(_mm512_sub_pd(_mm512_setzero_pd(), s)));
+
+	__mmask8 below_3 = _mm512_cmp_pd_mask(s, _mm512_set1_pd(3.0), _CMP_LT_OQ);
+	__mmask8 below_01 = _mm512_cmp_pd_mask(s, _mm512_set1_pd(0.1), _CMP_LT_OQ);
+	__m512d A = _mm512_mask_blend_pd(below_3, A_6, _mm512_div_pd(one, A_inv_3));
+	__m512d A_inv = _mm512_mask_blend_pd(below_3, _mm512_div_pd(one, A_6), A_inv_3);
+	A_inv = _mm512_mask_blend_pd(below_01, A_inv, s);
+	__m512d t = _mm512_maskz_mov_pd(~below_01,
+			exp_avx512(_mm512_mul_pd(_mm512_set1_pd(-2.0), A)));
+
+	__m512d cos_xi = _mm512_fmadd_pd(A_inv,
+			log_avx512(_mm512_fmadd_pd(_mm512_sub_pd(one, u), t, u)), one);
+	return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(s, _mm512_set1_pd(6.0), _CMP_LT_OQ),
+			_mm512_fmsub_pd(_mm512_set1_pd(2.0), u, one), cos_xi);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+__m512d coulomb_table_cos_xi_avx512(const CoulombTable &t, __m512d s, __m512d u)
+{
+	const __m512d one = _mm512_set1_pd(1.0);
+	__mmask8 below_3 = _mm512_cmp_pd_mask(s, _mm512_set1_pd(3.0), _CMP_LT_OQ);
+	__mmask8 middle = _mm512_cmp_pd_mask(s, _mm512_set1_pd(0.1), _CMP_GE_OQ)
+		& _mm512_cmp_pd_mask(s, _mm512_set1_pd(6.0), _CMP_LT_OQ);
+	__mmask8 in = middle & _mm512_cmp_pd_mask(u, _mm512_set1_pd(ldexp(1.0, -t.binades)),
+			_CMP_GE_OQ);
+
+	__m512d A_inv = _mm512_fmadd_pd(_mm512_set1_pd(0.02389567), s,
+			_mm512_set1_pd(-0.12788975));
+	A_inv = _mm512_fmadd_pd(A_inv, s, _mm512_set1_pd(0.47913906));
+	A_inv = _mm512_fmadd_pd(A_inv, s, _mm512_set1_pd(-0.508139));
+	A_inv = _mm512_fmadd_pd(A_inv, s, _mm512_set1_pd(0.9560202));
+	A_inv = _mm512_fmadd_pd(A_inv, s, _mm512_set1_pd(0.0056958));
+	__m512d x_A = _mm512_div_pd(_mm512_sub_pd(_mm512_div_pd(one, A_inv),
+				_mm512_set1_pd(t.A_min)), _mm512_set1_pd(t.del_A));
+	__m512d x_s = _mm512_add_pd(_mm512_set1_pd(t.rows_A), _mm512_div_pd(
+				_mm512_sub_pd(s, _mm512_set1_pd(3.0)), _mm512_set1_pd(t.del_s)));
+	__m512d x = _mm512_maskz_mov_pd(in, _mm512_mask_blend_pd(below_3, x_s, x_A));
+	__m512d x_min = _mm512_maskz_mov_pd(~below_3, _mm512_set1_pd(t.rows_A));
+	__m512d x_max = _mm512_mask_blend_pd(below_3, _mm512_set1_pd(t.rows_A + t.rows_s - 2),
+			_mm512_set1_pd(t.rows_A - 2));
+	__m512d x_i = _mm512_min_pd(_mm512_max_pd(_mm512_roundscale_pd(x,
+					_MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC), x_min), x_max);
+
+	/* u = f*2^e with f in [1, 2) */
+	__m512d e = _mm512_add_pd(_mm512_getexp_pd(u), _mm512_set1_pd(t.binades));
+	__m512d f = _mm512_getmant_pd(u, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_src);
+	__m512d y = _mm512_maskz_mov_pd(in, _mm512_mul_pd(_mm512_add_pd(e, _mm512_sub_pd(f, one)),
+				_mm512_set1_pd(t.per_binade)));
+	__m512d y_j = _mm512_min_pd(_mm512_roundscale_pd(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC),
+			_mm512_set1_pd(t.n_cols - 2));
+
+	const float *c = t.data.data();
+	__m256i k = _mm512_cvtpd_epi32(_mm512_fmadd_pd(x_i, _mm512_set1_pd(t.n_cols), y_j));
+	__m512d c00 = _mm512_cvtps_pd(_mm256_i32gather_ps(c, k, 4));
+	__m512d c01 = _mm512_cvtps_pd(_mm256_i32gather_ps(c + 1, k, 4));
+	__m512d c10 = _mm512_cvtps_pd(_mm256_i32gather_ps(c + t.n_cols, k, 4));
+	__m512d c11 = _mm512_cvtps_pd(_mm256_i32gather_ps(c + t.n_cols + 1, k, 4));
+	__m512d t_y = _mm512_sub_pd(y, y_j);
+	__m512d c0 = _mm512_fmadd_pd(t_y, _mm512_sub_pd(c01, c00), c00);
+	__m512d c1 = _mm512_fmadd_pd(t_y, _mm512_sub_pd(c11, c10), c10);
+	__m512d cos_xi = _mm512_fmadd_pd(_mm512_sub_pd(x, x_i), _mm512_sub_pd(c1, c0), c0);
+
+	__mmask8 below_01 = _mm512_cmp_pd_mask(s, _mm512_set1_pd(0.1), _CMP_LT_OQ);
+	if (below_01)
+		cos_xi = _mm512_mask_blend_pd(below_01, cos_xi,
+				_mm512_fmadd_pd(s, log_avx512(u), one));
+	cos_xi = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(s, _mm512_set1_pd(6.0), _CMP_NLT_UQ),
+			cos_xi, _mm512_fmsub_pd(_mm512_set1_pd(2.0), u, one));
+
+	__mmask8 rest = middle & ~in;
+	if (rest)
+		cos_xi = _mm512_mask_blend_pd(rest, cos_xi, coulomb_cos_xi_avx512(s, u));
+
+	return cos_xi;
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+void coulomb_avx512(const CoulombKernelArgs &a, int n)
+{
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d r1 = _mm512_set1_pd(a.m2/(a.m1 + a.m2));
+	const __m512d r2 = _mm512_set1_pd(a.m1/(a.m1 + a.m2));
+	const __m512d s_factor = _mm512_set1_pd(a.s_factor);
+
+	for (int i = 0; i < n; i += 8) {
+		/* the tail is masked, its lanes are computed from the relative
+		 * velocity 1 */
+		__mmask8 k = n - i >= 8 ? 0xff : (1 << (n - i)) - 1;
+		__m512d v1[3], v2[3], g[3];
+		for (int d = 0; d < 3; ++d) {
+			v1[d] = _mm512_mask_loadu_pd(one, k, a.v1[d] + i);
+			v2[d] = _mm512_maskz_loadu_pd(k, a.v2[d] + i);
+			g[d] = _mm512_sub_pd(v1[d], v2[d]);
+		}
+
+		__m512d g_perp2 = _mm512_fmadd_pd(g[1], g[1], _mm512_mul_pd(g[2], g[2]));
+		__m512d g2 = _mm512_fmadd_pd(g[0], g[0], g_perp2);
+		__m512d g_mag = _mm512_sqrt_pd(g2);
+		__m512d g_perp = _mm512_sqrt_pd(g_perp2);
+		__m512d s = _mm512_div_pd(s_factor, _mm512_mul_pd(g2, g_mag));
+
+		__m512d u = _mm512_mask_loadu_pd(one, k, a.u_xi + i);
+		__m512d cos_xi = a.table ? coulomb_table_cos_xi_avx512(*a.table, s, u)
+			: coulomb_cos_xi_avx512(s, u);
+		cos_xi = _mm512_min_pd(_mm512_max_pd(cos_xi, _mm512_set1_pd(-1.0)), one);
+		__m512d sin_xi = _mm512_sqrt_pd(_mm512_fnmadd_pd(cos_xi, cos_xi, one));
+
+		__m512d sin_eps, cos_eps;
+		sincos_2pi_avx512(_mm512_maskz_loadu_pd(k, a.u_eps + i), sin_eps, cos_eps);
+
+		__m512d h[3];
+		h[0] = _mm512_mul_pd(g_perp, cos_eps);
+		h[1] = _mm512_fmadd_pd(_mm512_mul_pd(g[1], g[0]), cos_eps,
+				_mm512_mul_pd(_mm512_mul_pd(g_mag, g[2]), sin_eps));
+		h[1] = _mm512_div_pd(_mm512_sub_pd(zero, h[1]), g_perp);
+		h[2] = _mm512_fmsub_pd(_mm512_mul_pd(g[2], g[0]), cos_eps,
+				_mm512_mul_pd(_mm512_mul_pd(g_mag, g[1]), sin_eps));
+		h[2] = _mm512_div_pd(_mm512_sub_pd(zero, h[2]), g_perp);
+
+		__m512d one_cos = _mm512_sub_pd(one, cos_xi);
+		for (int d = 0; d < 3; ++d) {
+			__m512d dv = _mm512_fmadd_pd(g[d], one_cos, _mm512_mul_pd(h[d], sin_xi));
+			_mm512_mask_storeu_pd(a.v1[d] + i, k, _mm512_fnmadd_pd(r1, dv, v1[d]));
+			_mm512_mask_storeu_pd(a.v2[d] + i, k, _mm512_fmadd_pd(r2, dv, v2[d]));
+		}
+	}
+}
+#endif
+
+SimdIsa simd_isa = detect_simd_isa();
+
+}
+
+SimdIsa detect_simd_isa()
+{
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SimdIsa::AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SimdIsa::AVX2;
+#endif
+	return SimdIsa::Scalar;
+}
+
+SimdIsa get_simd_isa()
+{
+	return simd_isa;
+}
+
+void set_simd_isa(SimdIsa isa)
+{
+	SimdIsa detected = detect_simd_isa();
+	simd_isa = (int)isa <= (int)detected ? isa : detected;
+}
+
+const char *simd_isa_name(SimdIsa isa)
+{
+	switch (isa) {
+		case SimdIsa::AVX2:
+			return "AVX2";
+		case SimdIsa::AVX512:
+			return "AVX-512";
+		default:
+			return "scalar";
+	}
+}
+
+PushKernel get_push_kernel()
+{
+#ifdef SIMD_X86
+	switch (simd_isa) {
+		case SimdIsa::AVX512:
+			return push_avx512;
+		case SimdIsa::AVX2:
+			return push_avx2;
+		default:
+			break;
+	}
+#endif
+	return nullptr;
+}
+
+StencilKernel get_stencil_kernel()
+{
+#ifdef SIMD_X86
+	switch (simd_isa) {
+		case SimdIsa::AVX512:
+			return stencil_avx512;
+		case SimdIsa::AVX2:
+			return stencil_avx2;
+		default:
+			break;
+	}
+#endif
+	return stencil_scalar;
+}
+
+DifferenceKernel get_difference_kernel()
+{
+#ifdef SIMD_X86
+	switch (simd_isa) {
+		case SimdIsa::AVX512:
+			return difference_avx512;
+		case SimdIsa::AVX2:
+			return difference_avx2;
+		default:
+			break;
+	}
+#endif
+	return difference_scalar;
+}
+
+CoulombKernel get_coulomb_kernel()
+{
+#ifdef SIMD_X86
+	switch (simd_isa) {
+		case SimdIsa::AVX512:
+			return coulomb_avx512;
+		case SimdIsa::AVX2:
+			return coulomb_avx2;
+		default:
+			break;
+	}
+#endif
+	return coulomb_scalar;
+}
+
+/* the exp(-A) + 2*u*sinh(A) of Nanbu's model is written as
+ * exp(A)*(u + (1 - u)*exp(-2*A)), which needs a single exp, the result is
+ * clamped to [-1, 1] against the tail of the small angle branch */
+double coulomb_cos_xi(double s, double u)
+{
+	double cos_xi;
+	if (s < 0.1) {
+		cos_xi = 1 + s*log(u);
+	} else if (s < 6.0) {
+		double A, A_inv;
+		if (s < 3.0) {
+			A_inv = nanbu_A_inv(s);
+			A = 1/A_inv;
+		} else {
+			A = 3*exp(-s);
+			A_inv = 1/A;
+		}
+		cos_xi = 1 + A_inv*log(u + (1 - u)*exp(-2*A));
+	} else {
+		cos_xi = 2*u - 1;
+	}
+
+	return std::min(std::max(cos_xi, -1.0), 1.0);
+}
+
+CoulombTable make_coulomb_table(double tolerance)
+{
+	CoulombTable t;
+	t.binades = 32;
+	t.A_min = 1/nanbu_A_inv(3.0);
+	const double A_max = 1/nanbu_A_inv(0.1);
+
+	/* cos_xi at row coordinate x and column coordinate y */
+	auto exact = [&t](double x, double y) {
+		int b = (int)y/t.per_binade;
+		double u = ldexp(1 + (y - b*t.per_binade)/t.per_binade, b - t.binades);
+		if (x < t.rows_A)
+			return nanbu_cos_xi(t.A_min + x*t.del_A, u);
+		return nanbu_cos_xi(3*exp(-3.0 - (x - t.rows_A)*t.del_s), u);
+	};
+
+	/* intervals */
+	int n_u = 4, n_A = 16, n_s = 8;
+	for (;;) {
+		t.per_binade = n_u;
+		t.n_cols = t.binades*n_u + 1;
+		t.rows_A = n_A + 1;
+		t.del_A = (A_max - t.A_min)/n_A;
+		t.rows_s = n_s + 1;
+		t.del_s = 3.0/n_s;
+
+		t.data.resize((t.rows_A + t.rows_s)*t.n_cols);
+		for (int i = 0; i < t.rows_A + t.rows_s; ++i)
+			for (int j = 0; j < t.n_cols; ++j)
+				t.data[i*t.n_cols + j] = exact(i, j);
+
+		/* the error along the rows comes from the columns and vice versa */
+		double error_u = 0, error_x = 0;
+		t.max_error = 0;
+		for (int i = 0; i < t.rows_A + t.rows_s - 1; ++i) {
+			if (i == t.rows_A - 1)
+				continue;
+
+			for (int j = 0; j < t.n_cols - 1; ++j) {
+				const float *c = t.data.data() + i*t.n_cols + j;
+				for (int a = 0; a < 4; ++a) {
+					for (int b = 0; b < 4; ++b) {
+						double tx = a/4.0, ty = b/4.0;
+						double c0 = c[0] + ty*(c[1] - c[0]);
+						double c1 = c[t.n_cols] + ty*(c[t.n_cols + 1] - c[t.n_cols]);
+						double error = fabs(c0 + tx*(c1 - c0) - exact(i + tx, j + ty));
+
+						if (a == 0)
+							error_u = std::max(error_u, error);
+						if (b == 0)
+							error_x = std::max(error_x, error);
+						t.max_error = std::max(t.max_error, error);
+					}
+				}
+			}
+		}
+
+		if (t.max_error <= std::max(tolerance, 1e-6))
+			break;
+
+		if (error_u >= error_x) {
+			n_u *= 2;
+		} else {
+			n_A *= 2;
+			n_s *= 2;
+		}
+	}
+
+	return t;
+}
+
+double coulomb_cos_xi(const CoulombTable &t, double s, double u)
+{
+	if (!(s >= 0.1 && s < 6.0) || u < ldexp(1.0, -t.binades))
+		return coulomb_cos_xi(s, u);
+
+	/* row coordinate */
+	double x;
+	int i_min, i_max;
+	if (s < 3.0) {
+		x = (1/nanbu_A_inv(s) - t.A_min)/t.del_A;
+		i_min = 0;
+		i_max = t.rows_A - 2;
+	} else {
+		x = t.rows_A + (s - 3.0)/t.del_s;
+		i_min = t.rows_A;
+		i_max = t.rows_A + t.rows_s - 2;
+	}
+	int i = std::min(std::max((int)std::floor(x), i_min), i_max);
+
+	/* column coordinate, u = m*2^e with m in [0.5, 1) */
+	int e;
+	double m = frexp(u, &e);
+	double y = (t.binades + e - 1 + 2*m - 1)*t.per_binade;
+	int j = std::min((int)y, t.n_cols - 2);
+
+	const float *c = t.data.data() + i*t.n_cols + j;
+	double tx = x - i, ty = y - j;
+	double c0 = c[0] + ty*(c[1] - c[0]);
+	double c1 = c[t.n_cols] + ty*(c[t.n_cols + 1] - c[t.n_cols]);
+	return c0 + tx*(c1 - c0);
+}
@@ -0,0 +1,120 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <vector>
+
+/* explicitly vectorized kernels, the instruction set is picked at runtime,
+ * so that a binary that is not built for the local cpu still uses the
+ * widest vectors available */
+enum class SimdIsa {Scalar, AVX2, AVX512};
+
+/* best instruction set supported by the cpu */
+SimdIsa detect_simd_isa();
+
+/* instruction set used by the kernels, defaults to the detected one */
+SimdIsa get_simd_isa();
+
+/* restrict the kernels to isa, e.g. for testing, an isa that the cpu does
+ * not support is replaced by the detected one */
+void set_simd_isa(SimdIsa isa);
+
+const char *simd_isa_name(SimdIsa isa);
+
+/* everything the leapfrog push of particles stored in absolute coordinates
+ * needs, component dim of the electric field at corner n of cell (i, j, k)
+ * is E[i*E_stride[0] + j*E_stride[1] + k*E_stride[2] + E_corner[n]
+ * + dim*E_comp_stride], see Domain::FieldStencil */
+struct PushKernelArgs {
+	double *x[3];
+	double *v[3];
+	double *dt;
+	const double *w_mp;
+
+	const double *E;
+	int E_stride[3];
+	int E_corner[8];
+	int E_comp_stride;
+	int c_max[3];		/* [-] index of the last cell */
+
+	double x_min[3], x_max[3], del_x[3];
+	double q, m;		/* [C], [kg] */
+	double time_step;	/* [s] */
+};
+
+/* kick and drift the particles [begin, end) that stay inside the domain,
+ * the indices of all other particles, i.e. dead particles, particles that
+ * hit a boundary and the scalar tail, are written to slow and have to be
+ * pushed by the caller, returns their number */
+using PushKernel = int (*)(const PushKernelArgs &args, int begin, int end,
+		int *slow);
+
+/* kernel for the current instruction set, nullptr for SimdIsa::Scalar */
+PushKernel get_push_kernel();
+
+/* 7 point stencil on a line of n consecutive nodes, for i in [0, n)
+ * y[i] = c[0]*x[i] + c[1]*(x[i - 1] + x[i + 1]) + c[2]*(x[i - sj] + x[i + sj])
+ *      + c[3]*(x[i - sk] + x[i + sk]) */
+using StencilKernel = void (*)(const double *x, double *y, int n, int sj, int sk,
+		const double *c);
+
+/* kernel for the current instruction set, a scalar loop for SimdIsa::Scalar */
+StencilKernel get_stencil_kernel();
+
+/* negative central difference on a line of n consecutive nodes, for i in
+ * [0, n) y[i] = -(x[i + s] - x[i - s])/d2 + e */
+using DifferenceKernel = void (*)(const double *x, double *y, int n, int s, double d2,
+		double e);
+
+/* kernel for the current instruction set, a scalar loop for SimdIsa::Scalar */
+DifferenceKernel get_difference_kernel();
+
+/* cosine of the scattering angle of Nanbu's model for the collision
+ * parameter s and the uniform random number u in [0, 1) */
+double coulomb_cos_xi(double s, double u);
+
+/* inverse CDF of the scattering angle of Nanbu's model for 0.1 <= s < 6,
+ * i.e. cos_xi(s, u) on a grid that is interpolated bilinearly, the first
+ * rows_A rows are uniform in A(s) for s < 3, so that the steep part of
+ * cos_xi at small u stays in place from row to row, the rows_s rows after
+ * them are uniform in s for 3 <= s <= 6, the columns are per_binade points
+ * in every binade of u in [2^-binades, 1], smaller u are sampled from the
+ * analytic form */
+struct CoulombTable {
+	std::vector<float> data;	/* rows of n_cols values */
+	int n_cols;
+	int per_binade, binades;
+	int rows_A, rows_s;
+	double A_min, del_A;		/* A of row 0, A step */
+	double del_s;				/* s step from 3 on */
+	double max_error;			/* of cos_xi, checked at 4x4 points per cell */
+};
+
+/* the grid is refined until max_error is below tolerance, the size grows
+ * like 1/tolerance, e.g. 0.4 MB for 1e-3, hence tolerance >= 1e-6 */
+CoulombTable make_coulomb_table(double tolerance);
+
+/* cos_xi from table, the analytic form outside of it */
+double coulomb_cos_xi(const CoulombTable &table, double s, double u);
+
+/* Nanbu's binary Coulomb collision of n pairs of particles, the velocities
+ * v1 and v2 of the pairs are updated in place, the collision parameter of a
+ * pair is s = s_factor/|v1 - v2|^3, its scattering angle is sampled with the
+ * uniform random number u_xi and its azimuth is 2*pi*u_eps */
+struct CoulombKernelArgs {
+	double *v1[3];
+	double *v2[3];
+	const double *u_xi;
+	const double *u_eps;
+
+	double m1, m2;		/* [kg] */
+	double s_factor;	/* [m^3/s^3] */
+
+	const CoulombTable *table;	/* nullptr for the analytic form */
+};
+
+using CoulombKernel = void (*)(const CoulombKernelArgs &args, int n);
+
+/* kernel for the current instruction set, a scalar loop for SimdIsa::Scalar */
+CoulombKernel get_coulomb_kernel();
+
+#endif
@@ -1,14 +1,27 @@
+#include <limits>
 #include "solver.hpp"
 #include "const.hpp"
 #include "domain.hpp"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 using namespace Eigen;
 using namespace Const;
 
-Solver::Solver(Domain &domain, int iter_max, double tol) :
-	domain{domain}, iter_max{iter_max}, tol{tol}
+int Solver::direct_node_limit = 10000;
+
+Solver::Solver(Domain &domain, int iter_max, double tol, SolverType type) :
+	domain{domain}, type{type}, iter_max{iter_max}, tol{tol}
 {
+#ifdef _OPENMP
+	n_threads = omp_get_max_threads();
+#else
+	n_threads = 1;
+#endif
+
 	Vector3d del_x = domain.get_del_x();
 	Vector3d del_x_2q = 1.0/del_x.array().pow(2);
 
@@ -33,25 +46,33 @@ Solver::Solver(Domain &domain, int iter_max, double tol) :
 				double y = j*del_x(Y);
 				double z = k*del_x(Z);
 
+				int electrode = -1;
 				if (i == 0 && !domain.is_periodic(Xmin)) {
-					domain.eval_field_BC(Xmin, b0, coeffs, u, at(i + 1,j,k), x, y, z);
+					electrode = domain.eval_field_BC(Xmin, b0, coeffs, u, at(i + 1,j,k), x, y, z);
 
 				} else if (i == ni - 1 && !domain.is_periodic(Xmax)) {
-					domain.eval_field_BC(Xmax, b0, coeffs, u, at(i - 1,j,k), x, y, z);
+					electrode = domain.eval_field_BC(Xmax, b0, coeffs, u, at(i - 1,j,k), x, y, z);
 
 				} else if (j == 0 && !domain.is_periodic(Ymin)) {
-					domain.eval_field_BC(Ymin, b0, coeffs, u, at(i,j + 1,k), x, y, z);
+					electrode = domain.eval_field_BC(Ymin, b0, coeffs, u, at(i,j + 1,k), x, y, z);
 
 				} else if (j == nj - 1 && !domain.is_periodic(Ymax)) {
-					domain.eval_field_BC(Ymax, b0, coeffs, u, at(i,j - 1,k), x, y, z);
+					electrode = domain.eval_field_BC(Ymax, b0, coeffs, u, at(i,j - 1,k), x, y, z);
 
 				} else if (k == 0 && !domain.is_periodic(Zmin)) {
-					domain.eval_field_BC(Zmin, b0, coeffs, u, at(i,j,k + 1), x, y, z);
+					electrode = domain.eval_field_BC(Zmin, b0, coeffs, u, at(i,j,k + 1), x, y, z);
 
 				} else if (k == nk - 1 && !domain.is_periodic(Zmax)) {
-					domain.eval_field_BC(Zmax, b0, coeffs, u, at(i,j,k - 1), x, y, z);
+					electrode = domain.eval_field_BC(Zmax, b0, coeffs, u, at(i,j,k - 1), x, y, z);
 
 				} else {
+					is_regular(u) = 1;
+
+					/* the stencil operator takes care of the interior rows */
+					if (type == SolverType::MatrixFree
+							&& StencilOperator::is_interior(domain, i, j, k))
+						continue;
+
 					int u_xm = (i == 0      ? at(ni - 2,j,k) : at(i - 1,j,k));
 					int u_xp = (i == ni - 1 ? at(     1,j,k) : at(i + 1,j,k));
 
@@ -71,8 +92,21 @@ Solver::Solver(Domain &domain, int iter_max, double tol) :
 
 					coeffs.push_back(T(u, u_zm, del_x_2q(Z)));
 					coeffs.push_back(T(u, u_zp, del_x_2q(Z)));
+				}
 
-					is_regular(u) = 1;
+				/* the voltage of an electrode is added in calc_potential, its
+				 * first node gives the initial voltage */
+				if (electrode >= 0) {
+					if (electrode >= (int)electrode_nodes.size()) {
+						electrode_nodes.resize(electrode + 1);
+						electrode_voltage.resize(electrode + 1, 0.0);
+					}
+
+					if (electrode_nodes[electrode].empty())
+						electrode_voltage[electrode] = b0(u);
+
+					electrode_nodes[electrode].push_back(u);
+					b0(u) = 0;
 				}
 			}
 		}
@@ -81,14 +115,130 @@ Solver::Solver(Domain &domain, int iter_max, double tol) :
 	A.resize(n_nodes, n_nodes);
 	A.setFromTriplets(coeffs.begin(), coeffs.end());
 
-	solver.setMaxIterations(iter_max);
-	solver.setTolerance(tol);
-	solver.compute(A);
+	/* small meshes are factorized, which also covers the Newton iteration
+	 * of calc_potential_BR */
+	if (type == SolverType::Auto && n_nodes <= direct_node_limit)
+		this->type = type = SolverType::Direct;
+
+	if (type == SolverType::Auto || type == SolverType::FFT) {
+		this->type = type = spectral.setup(A, domain) ? SolverType::FFT
+			: SolverType::BiCGSTAB;
+	}
+
+	symmetric = (type == SolverType::CG || type == SolverType::Direct)
+		&& reduced.setup(A, domain);
+
+	if (type == SolverType::CG && !symmetric)
+		this->type = type = SolverType::BiCGSTAB;
+
+	bool success = true;
+
+	/* the Newton iteration of calc_potential_BR can not be solved spectrally
+	 * or in single precision, the FFT and mixed precision solvers keep
+	 * BiCGSTAB for it */
+	if (type == SolverType::BiCGSTAB || type == SolverType::FFT
+			|| type == SolverType::MixedPrecision) {
+		solver.setMaxIterations(iter_max);
+		solver.setTolerance(tol);
+		solver.compute(A);
+		success = solver.info() == Success;
+
+		if (type == SolverType::MixedPrecision) {
+			A_float = A.cast<float>();
+			solver_float.setMaxIterations(iter_max);
+			solver_float.compute(A_float);
+			success = success && solver_float.info() == Success;
+		}
+
+	} else if (type == SolverType::CG) {
+		cg.setMaxIterations(iter_max);
+		cg.setTolerance(tol);
+		cg.compute(reduced.get_matrix());
+		success = cg.info() == Success;
+
+	} else if (type == SolverType::Direct) {
+		if (symmetric) {
+			ldlt.compute(reduced.get_matrix());
+			success = ldlt.info() == Success;
+		} else {
+			lu.compute(A);
+			success = lu.info() == Success;
+		}
+
+		if (success) {
+			cout << "Field Solver:" << endl;
+			cout << "  Factorization:        "
+				 << (symmetric ? "LDLT" : "LU") << endl;
+			cout << "  Factorization memory: "
+				 << get_factorization_memory()/1e6 << " MB" << endl << endl;
+		}
+
+	} else if (type == SolverType::MatrixFree) {
+		stencil.setup(domain, A);
+		A = SpMat();
+
+		VectorXd diag = stencil.diagonal();
+		inv_diag = diag.unaryExpr([](double d) {return d != 0 ? 1/d : 1;});
+
+	} else {
+		mg.setup(A, Vector3i(ni, nj, nk));
+
+		/* the Newton iteration of calc_potential_BR always runs BiCGSTAB
+		 * with the V-cycle of A as preconditioner */
+		mg_solver.setMaxIterations(iter_max);
+		mg_solver.setTolerance(tol);
+		mg_solver.preconditioner().set_multigrid(&mg);
+		mg_solver.compute(A);
+		success = mg_solver.info() == Success;
+	}
 
-	if (solver.info() != Success) {
+	if (!success) {
 		cerr << "Solver failed to decompose Matrix!" << endl;
 		exit(EXIT_FAILURE);
 	}
+
+	/* Laplace solution of every electrode at 1 V with all other boundary
+	 * values zero */
+	for (const vector<int> &nodes : electrode_nodes) {
+		VectorXd b = VectorXd::Zero(n_nodes);
+		for (int u : nodes)
+			b(u) = 1;
+
+		VectorXd x = VectorXd::Zero(n_nodes);
+		if (!solve(b, x)) {
+			cerr << "Solver failed to find a solution!" << endl;
+			exit(EXIT_FAILURE);
+		}
+
+		electrode_phi.push_back(x);
+	}
+
+	if (!electrode_nodes.empty())
+		phi_charge = VectorXd::Zero(n_nodes);
+}
+
+const char *solver_type_name(SolverType type)
+{
+	switch (type) {
+		case SolverType::BiCGSTAB:
+			return "BiCGSTAB";
+		case SolverType::Multigrid:
+			return "multigrid";
+		case SolverType::MultigridBiCGSTAB:
+			return "multigrid BiCGSTAB";
+		case SolverType::FFT:
+			return "FFT";
+		case SolverType::MatrixFree:
+			return "matrix-free BiCGSTAB";
+		case SolverType::CG:
+			return "CG";
+		case SolverType::Direct:
+			return "direct";
+		case SolverType::MixedPrecision:
+			return "mixed precision BiCGSTAB";
+		default:
+			return "auto";
+	}
 }
 
 void Solver::set_reference_values(double phi0, double Te0, double n0)
@@ -105,9 +255,38 @@ void Solver::calc_potential()
 
 	VectorXd b = b0.array() - (rho/EPS0).array()*is_regular.array();
 
-	domain.phi = solver.solveWithGuess(b, phi);
+	bool success = true;
+
+	/* the solvers were last set up for the Jacobian of calc_potential_BR */
+	if (J_factorized) {
+		if (type == SolverType::CG)
+			cg.factorize(reduced.get_matrix());
+		else if (type == SolverType::Direct && symmetric)
+			ldlt.factorize(reduced.get_matrix());
+		else if (type == SolverType::Direct)
+			lu.factorize(A);
+		else if (type == SolverType::BiCGSTAB || type == SolverType::FFT
+				|| type == SolverType::MixedPrecision)
+			solver.factorize(A);
+		else if (type != SolverType::MatrixFree)
+			mg_solver.factorize(A);
+
+		J_factorized = false;
+	}
 
-	if (solver.info() != Success) {
+	/* the boundary values of the electrodes are zero in b, their Laplace
+	 * solutions are added for the current voltages */
+	if (electrode_phi.empty()) {
+		success = solve(b, phi);
+	} else {
+		success = solve(b, phi_charge);
+
+		phi = phi_charge;
+		for (int e = 0; e < (int)electrode_phi.size(); ++e)
+			phi += electrode_voltage[e]*electrode_phi[e];
+	}
+
+	if (!success) {
 		cerr << "Solver failed to find a solution!" << endl;
 		exit(EXIT_FAILURE);
 	}
@@ -120,30 +299,45 @@ void Solver::calc_potential_BR()
 	VectorXd &n_e_BR = domain.n_e_BR;
 
 	VectorXd b = b0.array() - (rho/EPS0).array()*is_regular.array();
+	for (int e = 0; e < (int)electrode_nodes.size(); ++e) {
+		for (int u : electrode_nodes[e])
+			b(u) = electrode_voltage[e];
+	}
 
 	VectorXd del_phi = VectorXd::Zero(n_nodes);
 
 	for (int iter = 0; iter < newton_iter_max; ++iter) {
-		VectorXd R = A*phi - b;
+		VectorXd R = residual_BR(phi, b);
 
-		R.array() -= (QE/EPS0*n0*exp((phi.array() - phi0)/Te0))
+		VectorXd shift = (QE*n0/(EPS0*Te0)*exp((phi.array() - phi0)/Te0))
 			*is_regular.array();
 
-		SpMat J = A;
+		bool success = newton_type == NewtonType::JFNK
+			? solve_jacobian_free(phi, b, R, shift, del_phi)
+			: solve_jacobian(R, shift, del_phi);
 
-		J.diagonal().array() -= (QE*n0/(EPS0*Te0)*exp((phi.array() - phi0)/Te0))
-			*is_regular.array();
-
-		del_phi = solver.factorize(J).solveWithGuess(R, del_phi);
-
-		if (solver.info() != Success) {
+		if (!success) {
 			cerr << "Solver failed to find a solution!" << endl;
 			exit(EXIT_FAILURE);
 		}
 
-		phi -= del_phi;
+		/* backtrack until the residual decreases sufficiently, far from the
+		 * solution the exponential can make it grow along the whole Newton
+		 * direction although Newton converges, the full step is kept then */
+		double lambda = 1;
+		if (newton_type == NewtonType::JFNK) {
+			const double R_norm = R.norm();
+			while (lambda >= 1.0/64 && !(residual_BR(phi - lambda*del_phi, b).norm()
+					<= (1 - 1e-4*lambda)*R_norm))
+				lambda /= 2;
+
+			if (lambda < 1.0/64)
+				lambda = 1;
+		}
+
+		phi -= lambda*del_phi;
 
-		if (del_phi.norm() < newton_tol) {
+		if (lambda*del_phi.norm() < newton_tol) {
 			n_e_BR = n0*exp((phi.array() - phi0)/Te0);
 			return;
 		}
@@ -153,6 +347,350 @@ void Solver::calc_potential_BR()
 	exit(EXIT_FAILURE);
 }
 
+Solver::VectorXd Solver::residual_BR(const VectorXd &phi, const VectorXd &b) const
+{
+	VectorXd R = apply_operator(phi) - b;
+
+	R.array() -= (QE/EPS0*n0*exp((phi.array() - phi0)/Te0))
+		*is_regular.array();
+
+	return R;
+}
+
+bool Solver::solve_jacobian(const VectorXd &R, const VectorXd &shift, VectorXd &del_phi)
+{
+	/* a frozen preconditioner still sees the updated J, the iterative
+	 * solvers only keep a reference to it */
+	const bool refactorize = newton_type != NewtonType::FrozenNewton || !J_factorized;
+	bool success = true;
+
+	if (type == SolverType::MatrixFree) {
+		iterations = solve_matrix_free(R, del_phi, &shift);
+		return iterations >= 0;
+	}
+
+	update_jacobian(shift);
+
+	if (type == SolverType::CG) {
+		if (refactorize)
+			cg.factorize(J);
+
+		reduced.expand(cg.solveWithGuess(reduced.reduce(R),
+					reduced.restrict_to_unknowns(del_phi)), R, del_phi);
+		success = cg.info() == Success;
+		iterations = cg.iterations();
+		error = cg.error();
+
+	} else if (type == SolverType::Direct) {
+		/* the factors are the solve, they can not be frozen */
+		if (symmetric) {
+			ldlt.factorize(J);
+			reduced.expand(ldlt.solve(reduced.reduce(R)), R, del_phi);
+			success = ldlt.info() == Success;
+		} else {
+			lu.factorize(J);
+			del_phi = lu.solve(R);
+			success = lu.info() == Success;
+		}
+		iterations = 0;
+		error = 0;
+
+	} else if (type == SolverType::BiCGSTAB || type == SolverType::FFT
+			|| type == SolverType::MixedPrecision) {
+		if (refactorize)
+			solver.factorize(J);
+
+		del_phi = solver.solveWithGuess(R, del_phi);
+		success = solver.info() == Success;
+		iterations = solver.iterations();
+		error = solver.error();
+
+	} else {
+		/* the multigrid hierarchy of A preconditions J */
+		if (refactorize)
+			mg_solver.factorize(J);
+
+		del_phi = mg_solver.solveWithGuess(R, del_phi);
+		success = mg_solver.info() == Success;
+		iterations = mg_solver.iterations();
+		error = mg_solver.error();
+	}
+
+	J_factorized = true;
+
+	return success;
+}
+
+bool Solver::solve_jacobian_free(const VectorXd &phi, const VectorXd &b,
+		const VectorXd &R, const VectorXd &shift, VectorXd &del_phi)
+{
+	/* perturbation of Knoll and Keyes, h x is about sqrt(eps) relative to
+	 * the mean potential */
+	const double h0 = sqrt(numeric_limits<double>::epsilon())
+		*(1 + phi.lpNorm<1>()/phi.size());
+
+	auto op = [&](const VectorXd &x, VectorXd &y) {
+		double x_norm = x.norm();
+		if (x_norm == 0) {
+			y = VectorXd::Zero(x.size());
+			return;
+		}
+
+		double h = h0/x_norm;
+		y = (residual_BR(phi + h*x, b) - R)/h;
+	};
+
+	VectorXd diag = type == SolverType::MatrixFree ? stencil.diagonal() : A.diagonal();
+	VectorXd M = (diag - shift).unaryExpr([](double d) {return d != 0 ? 1/d : 1;});
+
+	auto precond = [&](const VectorXd &r, VectorXd &z) {z = M.cwiseProduct(r);};
+
+	iterations = bicgstab(op, precond, R, del_phi, iter_max, tol, error, n_threads);
+
+	return iterations >= 0;
+}
+
+void Solver::update_jacobian(const VectorXd &shift)
+{
+	const bool reduced_jacobian = type == SolverType::CG
+		|| (type == SolverType::Direct && symmetric);
+
+	if (J.size() == 0) {
+		J = reduced_jacobian ? reduced.get_matrix() : A;
+
+		/* make sure every diagonal entry is stored */
+		for (int u = 0; u < J.rows(); ++u)
+			J.coeffRef(u, u) += 0;
+		J.makeCompressed();
+
+		J_diagonal.resize(J.rows());
+		for (int u = 0; u < J.outerSize(); ++u) {
+			for (SpMat::InnerIterator it(J, u); it; ++it) {
+				if (it.row() == u)
+					J_diagonal[u] = &it.valueRef() - J.valuePtr();
+			}
+		}
+
+		J_diagonal0 = J.diagonal();
+	}
+
+	VectorXd diag = reduced_jacobian
+		? VectorXd(J_diagonal0 + reduced.restrict_to_unknowns(shift))
+		: VectorXd(J_diagonal0 - shift);
+
+	double *values = J.valuePtr();
+	for (int u = 0; u < J.rows(); ++u)
+		values[J_diagonal[u]] = diag(u);
+}
+
+size_t Solver::get_operator_memory() const
+{
+	if (type == SolverType::MatrixFree)
+		return stencil.memory();
+
+	auto memory = [](const SpMat &M) {
+		return M.nonZeros()*(sizeof(double) + sizeof(int)) + (M.outerSize() + 1)*sizeof(int);
+	};
+
+	/* the reduced system is kept next to A */
+	if (type == SolverType::CG)
+		return memory(A) + memory(reduced.get_matrix());
+
+	if (type == SolverType::MixedPrecision)
+		return memory(A) + A_float.nonZeros()*(sizeof(float) + sizeof(int))
+			+ (A_float.outerSize() + 1)*sizeof(int);
+
+	if (A_row.size() > 0)
+		return memory(A) + A_row.nonZeros()*(sizeof(double) + sizeof(int))
+			+ (A_row.outerSize() + 1)*sizeof(int);
+
+	return memory(A);
+}
+
+size_t Solver::get_factorization_memory() const
+{
+	if (type != SolverType::Direct)
+		return 0;
+
+	if (symmetric) {
+		const SpMat &L = ldlt.matrixL().nestedExpression();
+		return L.nonZeros()*(sizeof(double) + sizeof(int)) + (L.outerSize() + 1)*sizeof(int)
+			+ L.rows()*(sizeof(double) + 2*sizeof(int));
+	}
+
+	return (lu.nnzL() + lu.nnzU())*(sizeof(double) + sizeof(int));
+}
+
+Solver::VectorXd Solver::apply_operator(const VectorXd &x) const
+{
+	if (type != SolverType::MatrixFree)
+		return A*x;
+
+	VectorXd y;
+	stencil.apply(x, y);
+	return y;
+}
+
+int Solver::solve_parallel(const VectorXd &b, VectorXd &x)
+{
+	/* the rows of a row major matrix can be split over the threads */
+	if (A_row.size() == 0) {
+		A_row = A;
+		inv_diag = A.diagonal().unaryExpr([](double d) {return d != 0 ? 1/d : 1;});
+	}
+
+	auto op = [&](const VectorXd &x, VectorXd &y) {
+		y.resize(x.size());
+		for_blocks(x.size(), n_threads, [&](int i, int m) {
+			y.segment(i, m).noalias() = A_row.middleRows(i, m)*x;
+		});
+	};
+
+	auto precond = [&](const VectorXd &r, VectorXd &z) {
+		z.resize(r.size());
+		for_blocks(r.size(), n_threads, [&](int i, int m) {
+			z.segment(i, m) = inv_diag.segment(i, m).cwiseProduct(r.segment(i, m));
+		});
+	};
+
+	return bicgstab(op, precond, b, x, iter_max, tol, error, n_threads);
+}
+
+bool Solver::solve(const VectorXd &b, VectorXd &x)
+{
+	bool success = true;
+
+	switch (type) {
+		case SolverType::BiCGSTAB:
+			if (n_threads > 1) {
+				iterations = solve_parallel(b, x);
+				success = iterations >= 0;
+				break;
+			}
+
+			x = solver.solveWithGuess(b, x);
+			success = solver.info() == Success;
+			iterations = solver.iterations();
+			error = solver.error();
+			break;
+		case SolverType::MixedPrecision:
+			iterations = solve_mixed_precision(b, x);
+			success = iterations >= 0;
+			break;
+		case SolverType::Multigrid:
+			iterations = mg.solve(x, b, iter_max, tol);
+			success = iterations >= 0;
+			error = mg.get_error();
+			break;
+		case SolverType::MultigridBiCGSTAB:
+			x = mg_solver.solveWithGuess(b, x);
+			success = mg_solver.info() == Success;
+			iterations = mg_solver.iterations();
+			error = mg_solver.error();
+			break;
+		case SolverType::MatrixFree:
+			iterations = solve_matrix_free(b, x);
+			success = iterations >= 0;
+			break;
+		case SolverType::CG:
+			reduced.expand(cg.solveWithGuess(reduced.reduce(b),
+						reduced.restrict_to_unknowns(x)), b, x);
+			success = cg.info() == Success;
+			iterations = cg.iterations();
+			error = cg.error();
+			break;
+		case SolverType::Direct:
+			if (symmetric)
+				reduced.expand(ldlt.solve(reduced.reduce(b)), b, x);
+			else
+				x = lu.solve(b);
+			iterations = 0;
+			error = 0;
+			break;
+		case SolverType::FFT:
+			spectral.solve(b, x);
+			iterations = 0;
+			error = 0;
+			break;
+		default:
+			break;
+	}
+
+	return success;
+}
+
+int Solver::solve_mixed_precision(const VectorXd &b, VectorXd &x)
+{
+	const double b_norm = b.norm();
+	if (b_norm == 0) {
+		x.setZero();
+		error = 0;
+		return 0;
+	}
+
+	int inner_iterations = 0;
+	double r_norm_old = numeric_limits<double>::infinity();
+	for (int refinement = 0; refinement < max_refinements; ++refinement) {
+		VectorXd r = b - A*x;
+		double r_norm = r.norm();
+
+		error = r_norm/b_norm;
+		if (error <= tol)
+			return inner_iterations;
+
+		/* the single precision iteration stagnates */
+		if (r_norm > 0.5*r_norm_old)
+			break;
+		r_norm_old = r_norm;
+
+		/* aim a bit below tol, but not below what single precision resolves */
+		solver_float.setTolerance(max(0.5*tol*b_norm/r_norm, 1e-5));
+
+		Eigen::VectorXf d = solver_float.solve(r.cast<float>());
+		if (solver_float.info() == NumericalIssue || !d.allFinite())
+			break;
+
+		inner_iterations += solver_float.iterations();
+		x += d.cast<double>();
+	}
+
+	/* BiCGSTAB can break down in single precision, the solve is then
+	 * finished in double precision from the refined x */
+	x = solver.solveWithGuess(b, x);
+	error = solver.error();
+	inner_iterations += solver.iterations();
+
+	return solver.info() == Success ? inner_iterations : -1;
+}
+
+int Solver::solve_matrix_free(const VectorXd &b, VectorXd &x, const VectorXd *shift)
+{
+	auto op = [&](const VectorXd &x, VectorXd &y) {
+		stencil.apply(x, y, n_threads);
+		if (shift) {
+			for_blocks(x.size(), n_threads, [&](int i, int m) {
+				y.segment(i, m) -= shift->segment(i, m).cwiseProduct(x.segment(i, m));
+			});
+		}
+	};
+
+	VectorXd inv_diag_J;
+	if (shift) {
+		inv_diag_J = (stencil.diagonal() - *shift).unaryExpr(
+				[](double d) {return d != 0 ? 1/d : 1;});
+	}
+	const VectorXd &M = shift ? inv_diag_J : inv_diag;
+
+	auto precond = [&](const VectorXd &r, VectorXd &z) {
+		z.resize(r.size());
+		for_blocks(r.size(), n_threads, [&](int i, int m) {
+			z.segment(i, m) = M.segment(i, m).cwiseProduct(r.segment(i, m));
+		});
+	};
+
+	return bicgstab(op, precond, b, x, iter_max, tol, error, n_threads);
+}
+
 void Solver::calc_electric_field(const Vector3d &E_ext)
 {
 	const int &ni = domain.ni;
@@ -163,47 +701,95 @@ void Solver::calc_electric_field(const Vector3d &E_ext)
 	MatrixXd &E  = domain.E;
 
 	Vector3d del_x = domain.get_del_x();
-	double dx2 = 2*del_x(X);
-	double dy2 = 2*del_x(Y);
-	double dz2 = 2*del_x(Z);
+	const double d2[3] = {2*del_x(X), 2*del_x(Y), 2*del_x(Z)};
+	const int n[3] = {ni, nj, nk};
+	const int stride[3] = {1, ni, ni*nj};
+	const bool periodic[3] = {domain.is_periodic(Xmin), domain.is_periodic(Ymin),
+		domain.is_periodic(Zmin)};
+
+	const DifferenceKernel difference = get_difference_kernel();
+
+	/* the faces keep the one-sided or periodic differences */
+	auto face = [&](int dim, int i, int j, int k) {
+		double e;
+		if (dim == X) {
+			if (periodic[X])
+				e = -(phi(at(1,j,k)) - phi(at(ni - 2,j,k)))/d2[X];
+			else if (i == 0)
+				e = -(-3*phi(at(i,j,k)) + 4*phi(at(i + 1,j,k)) - phi(at(i + 2,j,k)))/d2[X];
+			else
+				e = -(phi(at(i - 2,j,k)) - 4*phi(at(i - 1,j,k)) + 3*phi(at(i,j,k)))/d2[X];
+		} else if (dim == Y) {
+			if (periodic[Y])
+				e = -(phi(at(i,1,k)) - phi(at(i,nj - 2,k)))/d2[Y];
+			else if (j == 0)
+				e = -(-3*phi(at(i,j,k)) + 4*phi(at(i,j + 1,k)) - phi(at(i,j + 2,k)))/d2[Y];
+			else
+				e = -(phi(at(i,j - 2,k)) - 4*phi(at(i,j - 1,k)) + 3*phi(at(i,j,k)))/d2[Y];
+		} else {
+			if (periodic[Z])
+				e = -(phi(at(i,j,1)) - phi(at(i,j,nk - 2)))/d2[Z];
+			else if (k == 0)
+				e = -(-3*phi(at(i,j,k)) + 4*phi(at(i,j,k + 1)) - phi(at(i,j,k + 2)))/d2[Z];
+			else
+				e = -(phi(at(i,j,k - 2)) - 4*phi(at(i,j,k - 1)) + 3*phi(at(i,j,k)))/d2[Z];
+		}
+		return e + E_ext(dim);
+	};
 
-	for (int i = 0; i < ni; ++i) {
+	auto plane = [&](int k) {
 		for (int j = 0; j < nj; ++j) {
-			for (int k = 0; k < nk; ++k) {
-				int u = at(i, j, k);
-
-				if (domain.is_periodic(Xmin) && (i == 0 || i == ni - 1)) {
-					E(u,X) = -(phi(at(1,j,k)) - phi(at(ni - 2,j,k)))/dx2;
-				} else if (i == 0) {
-					E(u,X) = -(-3*phi(at(i,j,k)) + 4*phi(at(i + 1,j,k)) - phi(at(i + 2,j,k)))/dx2;
-				} else if (i == ni - 1) {
-					E(u,X) = -(phi(at(i - 2,j,k)) - 4*phi(at(i - 1,j,k)) + 3*phi(at(i,j,k)))/dx2;
+			const int u = at(0, j, k);
+			const double *p = phi.data() + u;
+			double *e[3] = {&E(u, X), &E(u, Y), &E(u, Z)};
+
+			/* x, the first and the last node of the line are peeled off */
+			difference(p + 1, e[X] + 1, ni - 2, 1, d2[X], E_ext(X));
+			e[X][0] = face(X, 0, j, k);
+			e[X][ni - 1] = face(X, ni - 1, j, k);
+
+			/* y and z, a line is either interior or on a face as a whole */
+			const int idx[3] = {0, j, k};
+			for (int dim : {Y, Z}) {
+				if (0 < idx[dim] && idx[dim] < n[dim] - 1) {
+					difference(p, e[dim], ni, stride[dim], d2[dim], E_ext(dim));
 				} else {
-					E(u,X) = -(phi(at(i + 1,j,k)) - phi(at(i - 1,j,k)))/dx2;
-				}
-
-				if (domain.is_periodic(Ymin) && (j == 0 || j == nj - 1)) {
-					E(u,Y) = -(phi(at(i,1,k)) - phi(at(i,nj - 2,k)))/dy2;
-				} else if (j == 0) {
-					E(u,Y) = -(-3*phi(at(i,j,k)) + 4*phi(at(i,j + 1,k)) - phi(at(i,j + 2,k)))/dy2;
-				} else if (j == nj - 1) {
-					E(u,Y) = -(phi(at(i,j - 2,k)) - 4*phi(at(i,j - 1,k)) + 3*phi(at(i,j,k)))/dy2;
-				} else {
-					E(u,Y) = -(phi(at(i,j + 1,k)) - phi(at(i,j - 1,k)))/dy2;
+					for (int i = 0; i < ni; ++i)
+						e[dim][i] = face(dim, i, j, k);
 				}
+			}
+		}
+	};
+
+	const bool cache = domain.get_field_layout() != FieldLayout::ColumnMajor;
+	if (cache)
+		domain.allocate_field_cache();
+
+	#pragma omp parallel
+	{
+		int t = 0, n_threads = 1;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		n_threads = omp_get_num_threads();
+#endif
+
+		/* every thread takes a block of planes and refreshes the cache of the
+		 * cells below a plane as soon as the plane is done, only the last cell
+		 * plane of a block waits for the first plane of the next block */
+		int k_begin = (long)nk*t/n_threads;
+		int k_end = (long)nk*(t + 1)/n_threads;
+
+		for (int k = k_begin; k < k_end; ++k) {
+			plane(k);
+			if (cache && k > k_begin)
+				domain.update_field_cache(k - 1, k);
+		}
 
-				if (domain.is_periodic(Zmin) && (k == 0 || k == nk - 1)) {
-					E(u,Z) = -(phi(at(i,j,1)) - phi(at(i,j,nk - 2)))/dz2;
-				} else if (k == 0) {
-					E(u,Z) = -(-3*phi(at(i,j,k)) + 4*phi(at(i,j,k + 1)) - phi(at(i,j,k + 2)))/dz2;
-				} else if (k == nk - 1) {
-					E(u,Z) = -(phi(at(i,j,k - 2)) - 4*phi(at(i,j,k - 1)) + 3*phi(at(i,j,k)))/dz2;
-				} else {
-					E(u,Z) = -(phi(at(i,j,k + 1)) - phi(at(i,j,k - 1)))/dz2;
-				}
+		if (cache) {
+			#pragma omp barrier
 
-				E.row(u) += E_ext;
-			}
+			if (k_end > k_begin)
+				domain.update_field_cache(k_end - 1, k_end);
 		}
 	}
 }
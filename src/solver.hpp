@@ -2,17 +2,58 @@
 #define SOLVER_HPP
 
 #include <vector>
+#include <cstddef>
+#include <algorithm>
 #include <Eigen/Eigen>
 #include "domain.hpp"
+#include "multigrid.hpp"
+#include "spectral.hpp"
+#include "stencil.hpp"
+#include "krylov.hpp"
+#include "reduced.hpp"
+
+/* Auto: FFT if the boundary conditions allow it, BiCGSTAB otherwise
+ * BiCGSTAB: BiCGSTAB with diagonal preconditioner
+ * Multigrid: geometric multigrid V-cycles
+ * MultigridBiCGSTAB: BiCGSTAB preconditioned by a multigrid V-cycle
+ * FFT: direct spectral solve for boxes with periodic or Dirichlet faces,
+ * falls back to BiCGSTAB for any other box
+ * MatrixFree: BiCGSTAB with diagonal preconditioner on the stencil operator,
+ * no matrix is assembled for the interior nodes
+ * CG: conjugate gradients with incomplete Cholesky preconditioner on the
+ * symmetric system left after eliminating the boundary nodes, falls back to
+ * BiCGSTAB if the boundary conditions do not give a symmetric system
+ * Direct: sparse Cholesky (LDLT) of the symmetric system, or sparse LU of A
+ * if there is none, factorized once in the constructor
+ * MixedPrecision: BiCGSTAB with diagonal preconditioner in single precision
+ * inside an iterative refinement of the double precision residual
+ *
+ * Auto picks Direct for meshes with at most Solver::direct_node_limit nodes */
+enum class SolverType {Auto, BiCGSTAB, Multigrid, MultigridBiCGSTAB, FFT, MatrixFree,
+	CG, Direct, MixedPrecision};
+
+const char *solver_type_name(SolverType type);
+
+/* Newton iteration of Solver::calc_potential_BR
+ * Newton: the Jacobian A - diag(shift) keeps the pattern of the operator,
+ * only its diagonal is updated in place, the preconditioner (or the factors
+ * of SolverType::Direct) is rebuilt every iteration
+ * FrozenNewton: like Newton, but the preconditioner of the first Jacobian is
+ * kept for all further iterations and time steps
+ * JFNK: Jacobian-free Newton-Krylov, BiCGSTAB on finite differences of the
+ * residual with a Jacobi preconditioner and a backtracking line search */
+enum class NewtonType {Newton, FrozenNewton, JFNK};
 
 class Solver {
 	public:
 		using T = Eigen::Triplet<double>;
 		using SpMat = Eigen::SparseMatrix<double>;
+		using RowSpMat = Eigen::SparseMatrix<double, Eigen::RowMajor>;
 		using Vector3d = Eigen::Vector3d;
 		using VectorXd = Eigen::VectorXd;
 
-		Solver(Domain &domain, int iter_max, double tol);
+		Solver(Domain &domain, int iter_max, double tol,
+				SolverType type = SolverType::Auto);
 
 		void set_reference_values(double phi0, double Te0, double n0);
 
@@ -20,8 +61,47 @@ class Solver {
 
 		void calc_potential_BR();
 
+		void set_newton_type(NewtonType type) {newton_type = type;}
+
 		void calc_electric_field(const Vector3d &E_ext = {0, 0, 0});
 
+		/* the solver actually used, never SolverType::Auto */
+		SolverType get_type() const {return type;}
+
+		/* iterations and relative residual of the last linear solve */
+		int get_iterations() const {return iterations;}
+		double get_error() const {return error;}
+
+		/* [B] memory of the assembled or matrix-free operator */
+		std::size_t get_operator_memory() const;
+
+		/* [B] memory of the factors of SolverType::Direct */
+		std::size_t get_factorization_memory() const;
+
+		/* threads of the BiCGSTAB and matrix-free solves, independent of the
+		 * threads of the particles, all OpenMP threads by default */
+		void set_threads(int n_threads) {this->n_threads = std::max(n_threads, 1);}
+
+		int get_threads() const {return n_threads;}
+
+		/* [V] voltage of an electrode (see BC::set_electrode), the Laplace
+		 * solution of every electrode is computed once in the constructor,
+		 * calc_potential solves for the charge only and adds them scaled by
+		 * the voltages */
+		void set_electrode_voltage(int electrode, double voltage) {
+			electrode_voltage.at(electrode) = voltage;
+		}
+
+		double get_electrode_voltage(int electrode) const {
+			return electrode_voltage.at(electrode);
+		}
+
+		int get_electrode_count() const {return (int)electrode_voltage.size();}
+
+		/* largest mesh SolverType::Auto solves directly, applies to the
+		 * solvers constructed afterwards */
+		static void set_direct_node_limit(int n_nodes) {direct_node_limit = n_nodes;}
+
 	private:
 		Domain &domain;
 
@@ -32,12 +112,86 @@ class Solver {
 		VectorXd b0;
 		Eigen::BiCGSTAB<SpMat> solver;
 
+		SolverType type;
+		Multigrid mg;
+		Eigen::BiCGSTAB<SpMat, MultigridPreconditioner> mg_solver;
+		SpectralSolver spectral;
+		StencilOperator stencil;
+		VectorXd inv_diag;
+		ReducedSystem reduced;
+		/* the mesh order keeps the factor banded, a fill reducing ordering
+		 * like AMD makes the preconditioner several times slower */
+		Eigen::ConjugateGradient<SpMat, Eigen::Lower | Eigen::Upper,
+			Eigen::IncompleteCholesky<double, Eigen::Lower, Eigen::NaturalOrdering<int>>> cg;
+		Eigen::SimplicialLDLT<SpMat> ldlt;
+		Eigen::SparseLU<SpMat> lu;
+		bool symmetric = false;		/* the reduced system is used */
+
+		static int direct_node_limit;
+
+		NewtonType newton_type = NewtonType::Newton;
+		SpMat J;						/* Jacobian, pattern of A or of the reduced matrix */
+		std::vector<int> J_diagonal;	/* position of the diagonal entries in J */
+		VectorXd J_diagonal0;			/* diagonal of J without the shift */
+		bool J_factorized = false;		/* the solvers are set up for J, not for A */
+
+		Eigen::SparseMatrix<float> A_float;
+		Eigen::BiCGSTAB<Eigen::SparseMatrix<float>> solver_float;
+		int max_refinements = 10;
+
+		std::vector<std::vector<int>> electrode_nodes;	/* Dirichlet nodes of every electrode */
+		std::vector<double> electrode_voltage;
+		std::vector<VectorXd> electrode_phi;	/* Laplace solution for 1 V on the electrode */
+		VectorXd phi_charge;					/* phi without the electrodes */
+
+		int n_threads;
+		RowSpMat A_row;		/* A for the parallel products, set up on first use */
+
+		int iterations = 0;
+		double error = 0;
+
 		int iter_max, newton_iter_max = 20;
 		double tol, newton_tol = 1e-4;
 
 		double phi0, n0, Te0;
 
 		int at(int i, int j, int k) const {return domain.at(i, j, k);}
+
+		/* A x, also without an assembled A */
+		VectorXd apply_operator(const VectorXd &x) const;
+
+		/* residual of the Boltzmann relation at phi */
+		VectorXd residual_BR(const VectorXd &phi, const VectorXd &b) const;
+
+		/* solve J del_phi = R, with J = A - diag(shift) updated in place */
+		bool solve_jacobian(const VectorXd &R, const VectorXd &shift, VectorXd &del_phi);
+
+		/* solve J del_phi = R with J applied by finite differences of the
+		 * residual around phi */
+		bool solve_jacobian_free(const VectorXd &phi, const VectorXd &b, const VectorXd &R,
+				const VectorXd &shift, VectorXd &del_phi);
+
+		/* set up J = A - diag(shift) on the first call, afterwards only
+		 * overwrite its diagonal */
+		void update_jacobian(const VectorXd &shift);
+
+		/* solve A x = b with the solver of type starting from x, sets
+		 * iterations and error */
+		bool solve(const VectorXd &b, VectorXd &x);
+
+		/* single precision BiCGSTAB on the residual of x until the double
+		 * precision residual is below tol, returns the number of inner
+		 * iterations or -1 */
+		int solve_mixed_precision(const VectorXd &b, VectorXd &x);
+
+		/* BiCGSTAB with diagonal preconditioner on n_threads threads,
+		 * returns the number of iterations or -1 */
+		int solve_parallel(const VectorXd &b, VectorXd &x);
+
+		/* BiCGSTAB on the stencil operator minus diag(shift), returns the
+		 * number of iterations or -1 */
+		int solve_matrix_free(const VectorXd &b, VectorXd &x,
+				const VectorXd *shift = nullptr);
 };
 
 #endif
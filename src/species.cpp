@@ -1,3 +1,4 @@
+#include <numeric>
 #include "species.hpp"
 #include "random.hpp"
 
@@ -5,8 +6,10 @@ using namespace std;
 using namespace Eigen;
 using namespace Const;
 
-Species::Species(string name, double m, double q, double w_mp0, Domain &domain) :
-	name{name}, m{m}, q{q}, w_mp0{w_mp0}, domain{domain}
+Species::Species(string name, double m, double q, double w_mp0, Domain &domain,
+		Precision precision) :
+	name{name}, m{m}, q{q}, w_mp0{w_mp0}, particles{precision},
+	deposition{domain}, domain{domain}
 {
 	int n_nodes = domain.n_nodes;
 	int n_cells = domain.n_cells;
@@ -15,42 +18,64 @@ Species::Species(string name, double m, double q, double w_mp0, Domain &domain)
 	T        = VectorXd::Zero(n_nodes);
 	v_stream = MatrixXd::Zero(n_nodes, 3);
 	mp_count = VectorXd::Zero(n_cells);
-	n_sum    = VectorXd::Zero(n_nodes);
-	nv_sum   = MatrixXd::Zero(n_nodes, 3);
-	nuu_sum  = VectorXd::Zero(n_nodes);
-	nvv_sum  = VectorXd::Zero(n_nodes);
-	nww_sum  = VectorXd::Zero(n_nodes);
+	moments.assign(N_MOMENTS*n_nodes, 0.0);
 }
 
 double Species::get_real_count() const
 {
+	const double *w_mp = particles.w_mp_data();
+
 	double w_mp_sum = 0;
-	for(const Particle &p : particles)
-		w_mp_sum += p.w_mp;
+	for (int p = 0; p < particles.size(); ++p)
+		w_mp_sum += w_mp[p];
 	return w_mp_sum;
 }
 
 Vector3d Species::get_momentum() const
 {
+	const double *w_mp = particles.w_mp_data();
+
 	Vector3d I = Vector3d::Zero();
-	for(const Particle &p : particles)
-		I += p.w_mp*p.v;
+	particles.visit([&](auto real) {
+		using Real = decltype(real);
+		for(int dim : {X, Y, Z}) {
+			const Real *v = particles.v_data<Real>(dim);
+			for (int p = 0; p < particles.size(); ++p)
+				I(dim) += w_mp[p]*v[p];
+		}
+	});
 	return m*I;
 }
 
 double Species::get_kinetic_energy() const
 {
+	const double *w_mp = particles.w_mp_data();
+
 	double E_kin = 0;
-	for(const Particle &p : particles)
-		E_kin += p.w_mp*p.v.squaredNorm();
+	particles.visit([&](auto real) {
+		using Real = decltype(real);
+		const Real *vx = particles.v_data<Real>(X);
+		const Real *vy = particles.v_data<Real>(Y);
+		const Real *vz = particles.v_data<Real>(Z);
+
+		for (int p = 0; p < particles.size(); ++p)
+			E_kin += w_mp[p]*((double)vx[p]*vx[p] + (double)vy[p]*vy[p]
+					+ (double)vz[p]*vz[p]);
+	});
 	return 0.5*m*E_kin;
 }
 
 Vector3d Species::get_translation_temperature() const
 {
 	Vector3d c2_mean = Vector3d::Zero();
-	for(const Particle &p : particles)
-		c2_mean.array() += p.v.array().pow(2);
+	particles.visit([&](auto real) {
+		using Real = decltype(real);
+		for(int dim : {X, Y, Z}) {
+			const Real *v = particles.v_data<Real>(dim);
+			for (int p = 0; p < particles.size(); ++p)
+				c2_mean(dim) += (double)v[p]*v[p];
+		}
+	});
 	return m/(K*get_sim_count())*c2_mean;
 }
 
@@ -61,10 +86,12 @@ double Species::get_maxwellian_velocity_magnitude(double T) const
 
 Vector3d Species::get_maxwellian_velocity(const vector<double> T) const
 {
+	RandomNumberGenerator &gen = thread_rng();
+
 	Vector3d v;
 	for(int dim : {X, Y, Z}) {
 		double v_th = sqrt(2*K*T[dim]/m);
-		v(dim) = sqrt(0.5)*v_th*rng.normal();
+		v(dim) = sqrt(0.5)*v_th*gen.normal();
 	}
 	return v;
 }
@@ -82,9 +109,11 @@ void Species::add_particle(const Vector3d &x, const Vector3d &v, double dt)
 void Species::add_particle(const Vector3d &x, const Vector3d &v, double dt, double w_mp)
 {
 	Vector3d l = domain.x_to_l(x);
-	Vector3d E_p = domain.gather(domain.E, l);
+	Vector3d E_p = domain.gather_E(l);
 	Vector3d dv = q/m*E_p*0.5*domain.get_time_step();
 	particles.push_back(Particle(x, v - dv, dt, w_mp));
+	round_inside(particles.size() - 1);
+	invalidate_cells();
 }
 
 void Species::add_cold_box(const Vector3d &x1, const Vector3d &x2, double n,
@@ -124,56 +153,462 @@ void Species::add_warm_box(const Vector3d &x1, const Vector3d &x2, double n,
 	}
 }
 
-void Species::push_particles_leapfrog()
+template <>
+void Species::moment_values<1>(int p, double *val) const
 {
-	for(Particle &p : particles) {
+	val[0] = particles.w_mp(p);
+}
+
+template <>
+void Species::moment_values<Species::N_MOMENTS>(int p, double *val) const
+{
+	const double w_mp = particles.w_mp(p);
+	Vector3d v = particles.v(p);
+	val[MN]   = w_mp;
+	val[MNU]  = w_mp*v(X);
+	val[MNV]  = w_mp*v(Y);
+	val[MNW]  = w_mp*v(Z);
+	val[MNUU] = w_mp*v(X)*v(X);
+	val[MNVV] = w_mp*v(Y)*v(Y);
+	val[MNWW] = w_mp*v(Z)*v(Z);
+	val[MNUV] = w_mp*v(X)*v(Y);
+	val[MNUW] = w_mp*v(X)*v(Z);
+	val[MNVW] = w_mp*v(Y)*v(Z);
+}
+
+template <typename Real>
+auto Species::cell_relative_pusher()
+{
+	const Vector3d x_min = domain.get_x_min();
+	const Vector3d del_x = domain.get_del_x();
+	const Vector3d inv_del_x = del_x.cwiseInverse();
+	const Vector3i n_cells = domain.nn - Vector3i::Ones();
+	const double dt_step = domain.get_time_step();
+
+	int *c[3];
+	Real *d[3], *v[3];
+	for (int dim : {X, Y, Z}) {
+		c[dim] = particles.c_data(dim);
+		d[dim] = particles.x_data<Real>(dim);
+		v[dim] = particles.v_data<Real>(dim);
+	}
+	double *dt = particles.dt_data();
+	const double *w_mp = particles.w_mp_data();
+
+	return [=](int p) {
+		Vector3i c_p(c[X][p], c[Y][p], c[Z][p]);
+		Vector3d d_p(d[X][p], d[Y][p], d[Z][p]);
+
+		Vector3d E_p = domain.gather_E(c_p, d_p);
+		Vector3d v_p = Vector3d(v[X][p], v[Y][p], v[Z][p]) + E_p*(dt[p]*q/m);
+
+		/* drift in cell units and carry whole cells over to the index */
+		Vector3d d_new = d_p + v_p.cwiseProduct(inv_del_x)*dt[p];
+		Vector3d shift = d_new.array().floor();
+		Vector3i c_new = c_p + shift.cast<int>();
+		d_new -= shift;
+
+		bool inside = dt[p] > 0 && w_mp[p] > 0
+			&& (c_new.array() >= 0).all()
+			&& (c_new.array() < n_cells.array()).all()
+			&& (c_new.array() > 0 || d_new.array() > 0).all();
+
+		if (inside) {
+			for (int dim : {X, Y, Z}) {
+				c[dim][p] = c_new(dim);
+				d[dim][p] = min((Real)d_new(dim), nextafter(Real(1), Real(0)));
+				v[dim][p] = v_p(dim);
+			}
+			dt[p] = dt_step;
+			return;
+		}
+
+		/* the particle hits a boundary, which is handled in physical
+		 * coordinates starting from its position before the drift */
+		Vector3d x_p = x_min + (c_p.cast<double>() + d_p).cwiseProduct(del_x);
+		Particle part(x_p, v_p, dt[p], w_mp[p]);
+		move_particle(part);
+		particles.set(p, part);
+	};
+}
+
+template <typename F>
+void Species::visit_pusher(F &&f)
+{
+	auto absolute_pusher = [this](int i) {
+		if (particles.w_mp(i) <= 0) return;
+
+		Particle p = particles.get(i);
+
 		Vector3d l = domain.x_to_l(p.x);
-		Vector3d E_p = domain.gather(domain.E, l);
+		Vector3d E_p = domain.gather_E(l);
 
 		p.v += E_p*(p.dt*q/m);
 
-		int n_bounces = 0;
-
-		while (p.dt > 0 && p.w_mp > 0) {
-			Vector3d x_old = p.x;
-			p.x += p.v*p.dt;
+		move_particle(p);
+
+		particles.set(i, p);
+		round_inside(i);
+	};
+
+	auto range = [](auto push) {
+		return [push](int begin, int end) {
+			for (int p = begin; p < end; ++p)
+				push(p);
+		};
+	};
+
+	PushKernel kernel = get_push_kernel();
+
+	if (particles.is_cell_relative() && particles.is_single()) {
+		f(range(cell_relative_pusher<float>()));
+	} else if (particles.is_cell_relative()) {
+		f(range(cell_relative_pusher<double>()));
+	} else if (particles.is_single() || !kernel) {
+		f(range(absolute_pusher));
+	} else {
+		Domain::FieldStencil E = domain.get_E_stencil();
+
+		PushKernelArgs args;
+		for (int dim : {X, Y, Z}) {
+			args.x[dim] = particles.x_data(dim);
+			args.v[dim] = particles.v_data(dim);
+			args.c_max[dim] = domain.nn(dim) - 2;
+			args.E_stride[dim] = E.stride[dim];
+			args.x_min[dim] = domain.get_x_min()(dim);
+			args.x_max[dim] = domain.get_x_max()(dim);
+			args.del_x[dim] = domain.get_del_x()(dim);
+		}
+		args.dt = particles.dt_data();
+		args.w_mp = particles.w_mp_data();
+		args.E = E.data;
+		for (int n = 0; n < 8; ++n)
+			args.E_corner[n] = E.corner[n];
+		args.E_comp_stride = E.comp_stride;
+		args.q = q;
+		args.m = m;
+		args.time_step = domain.get_time_step();
+
+		/* the vectorized kernel leaves boundary particles to the scalar push */
+		f([=](int begin, int end) {
+			int slow[push_chunk];
+			for (int b = begin; b < end; b += push_chunk) {
+				int n_slow = kernel(args, b, min(b + push_chunk, end), slow);
+				for (int s = 0; s < n_slow; ++s)
+					absolute_pusher(slow[s]);
+			}
+		});
+	}
+}
 
-			if (!domain.is_inside(p.x)) {
-				domain.apply_boundary_conditions(*this, x_old, p);
-				continue;
+template <int N>
+void Species::push_and_deposit(double *f)
+{
+	invalidate_cells();
+
+	const int n_sim = particles.size();
+	const double *w_mp = particles.w_mp_data();
+	cells.resize(n_sim);
+
+	/* the colored tiles would need the cells after the push */
+	DepositionScheme scheme = deposition.select_scheme(N);
+	if (scheme == DepositionScheme::ColoredTiles)
+		scheme = DepositionScheme::PrivateGrids;
+
+	/* [begin, live_end) are the particles of block t that are still alive */
+	vector<int> block_begin(Deposition::max_threads(), 0);
+	vector<int> block_end(Deposition::max_threads(), 0);
+	vector<int> live_end(Deposition::max_threads(), 0);
+
+	visit_pusher([&](auto push) {
+		deposition.deposit_blocks<N>(scheme, f, n_sim,
+				[&](int t, int begin, int end, double *g) {
+			int live = begin;
+			for (int b = begin; b < end; b += push_chunk) {
+				int e = min(b + push_chunk, end);
+				push(b, e);
+
+				for (int p = b; p < e; ++p) {
+					if (w_mp[p] <= 0) continue;
+
+					Vector3i c;
+					Vector3d d;
+					double val[N];
+					locate(p, c, d);
+					moment_values<N>(p, val);
+					deposition.scatter<N>(g, c, d, val);
+
+					/* compact the block on the fly, the cell is kept for the
+					 * cell index */
+					if (live != p) particles.copy(p, live);
+					cells[live++] = domain.cell_at(c(X), c(Y), c(Z));
+				}
 			}
 
-			p.dt = 0;
+			block_begin[t] = begin;
+			block_end[t] = end;
+			live_end[t] = live;
+		});
+	});
+
+	int n_alive = 0;
+	for (size_t t = 0; t < live_end.size(); ++t)
+		n_alive += live_end[t] - block_begin[t];
+
+	/* close the gaps at the end of the blocks with the last particles */
+	int s = (int)live_end.size() - 1, q = live_end[s];
+	for (size_t t = 0; t < live_end.size(); ++t) {
+		for (int h = live_end[t]; h < block_end[t] && h < n_alive; ++h) {
+			while (q <= block_begin[s]) q = live_end[--s];
+			particles.copy(--q, h);
+			cells[h] = cells[q];
+		}
+	}
+
+	particles.resize(n_alive);
+	cells.resize(n_alive);
+	cells_valid = true;
+}
+
+void Species::push_particles_leapfrog()
+{
+	invalidate_cells();
+
+	visit_pusher([&](auto push) {
+		const int n_sim = particles.size();
+
+		/* boundary particles take longer, hence the dynamic schedule */
+		#pragma omp parallel for schedule(dynamic)
+		for (int begin = 0; begin < n_sim; begin += 4096)
+			push(begin, min(begin + 4096, n_sim));
+	});
+
+	/* regroup the particles by cell every sort_interval steps */
+	if (sort_interval > 0 && ++steps_since_sort >= sort_interval)
+		sort_particles();
+}
+
+void Species::push_particles_and_deposit(bool sample_moments)
+{
+	if (sample_moments) {
+		moments.assign(N_MOMENTS*domain.n_nodes, 0.0);
+		push_and_deposit<N_MOMENTS>(moments.data());
+		for (int u = 0; u < domain.n_nodes; ++u)
+			n(u) = get_moment(u, MN);
+	} else {
+		n.setZero();
+		push_and_deposit<1>(n.data());
+	}
+
+	synchronize_number_density();
+
+	/* regroup the particles by cell every sort_interval steps */
+	if (sort_interval > 0 && ++steps_since_sort >= sort_interval)
+		sort_particles();
+}
+
+void Species::move_particle(Particle &p) const
+{
+	int n_bounces = 0;
 
+	while (p.dt > 0 && p.w_mp > 0) {
+		Vector3d x_old = p.x;
+		p.x += p.v*p.dt;
+
+		if (!domain.is_inside(p.x)) {
+			domain.apply_boundary_conditions(*this, x_old, p);
+
+			/* remove particles that keep bouncing, e.g. because they got
+			 * stuck exactly on a wall with a vanishing time step */
 			if (++n_bounces > 10) {
 				p.w_mp = 0;
 			}
+			continue;
 		}
 
-		p.dt += domain.get_time_step();
+		p.dt = 0;
+	}
+
+	/* a diffuse wall can leave a particle with no time left exactly on
+	 * the wall, where it can not be gathered anymore */
+	if (p.w_mp > 0 && !domain.is_inside(p.x))
+		p.w_mp = 0;
+
+	p.dt += domain.get_time_step();
+}
+
+void Species::round_inside(int p)
+{
+	if (!particles.is_single() || particles.is_cell_relative()
+			|| particles.w_mp(p) <= 0)
+		return;
+
+	/* rounding to single precision must not move a particle that is just
+	 * inside onto or across the domain boundary */
+	Vector3d x_min = domain.get_x_min();
+	Vector3d x_max = domain.get_x_max();
+	for (int dim : {X, Y, Z}) {
+		float &x = particles.x_data<float>(dim)[p];
+		while (x <= x_min(dim)) x = nextafter(x,  HUGE_VALF);
+		while (x >= x_max(dim)) x = nextafter(x, -HUGE_VALF);
 	}
 }
 
 void Species::remove_dead_particles()
 {
+	const double *w_mp = particles.w_mp_data();
+
 	int n_sim = get_sim_count();
 	for (int p = 0; p < n_sim; ++p) {
-		if (particles[p].w_mp > 0) continue;
-		particles[p] = particles[n_sim - 1];
+		if (w_mp[p] > 0) continue;
+		particles.copy(n_sim - 1, p);
 		--n_sim;
 		--p;
 	}
-	particles.erase(particles.begin() + n_sim, particles.end());
+
+	if (n_sim < get_sim_count()) {
+		particles.resize(n_sim);
+		invalidate_cells();
+	}
 }
 
-void Species::calc_number_density()
+void Species::set_position_encoding(PositionEncoding encoding)
 {
-	n.setZero();
-	for(const Particle &p : particles) {
-		Vector3d l = domain.x_to_l(p.x);
-		domain.scatter(n, l, p.w_mp);
+	particles.set_encoding(encoding, domain.get_x_min(), domain.get_del_x(),
+			domain.nn - Vector3i::Ones());
+}
+
+void Species::set_sorting(int interval, bool adaptive)
+{
+	sort_interval = interval;
+	adaptive_sorting = adaptive;
+	steps_since_sort = 0;
+
+	/* the adaptive interval may move within a factor of 16 of the initial one */
+	sort_interval_min = max(1, interval/16);
+	sort_interval_max = max(1, interval*16);
+}
+
+void Species::sort_particles()
+{
+	const int n_sim = get_sim_count();
+	int n_moved = bin_particles(sort_order, cell_offsets);
+
+	particles.reorder(sort_order);
+
+	/* the particles of a cell are now in place */
+	cells_valid = false;
+	cell_index.order.resize(sort_order.size());
+	iota(cell_index.order.begin(), cell_index.order.end(), 0);
+	cell_index.offsets = cell_offsets;
+	cell_index_valid = true;
+
+	sorted = true;
+	steps_since_sort = 0;
+
+	/* sort less often if the particles barely moved since the last sort,
+	 * more often if most of them ended up in a different place */
+	if (adaptive_sorting && n_sim > 0) {
+		double moved = n_moved/(double)n_sim;
+		if (moved < 0.1) {
+			sort_interval = min(2*sort_interval, sort_interval_max);
+		} else if (moved > 0.5) {
+			sort_interval = max(sort_interval/2, sort_interval_min);
+		}
+	}
+}
+
+int Species::bin_particles(vector<int> &order, vector<int> &offsets)
+{
+	const int n_cells = domain.n_cells;
+	const int n_sim = get_sim_count();
+	const double *w_mp = particles.w_mp_data();
+
+	/* the cells recorded by the push are reused */
+	if (!cells_valid) {
+		cells.resize(n_sim);
+		for (int p = 0; p < n_sim; ++p)
+			cells[p] = w_mp[p] > 0 ? get_cell(p) : -1;
+		cells_valid = true;
+	}
+
+	/* counting sort by cell index, dead particles are dropped on the way */
+	offsets.assign(n_cells + 1, 0);
+	for (int p = 0; p < n_sim; ++p) {
+		if (cells[p] >= 0)
+			++offsets[cells[p] + 1];
+	}
+
+	for (int c = 0; c < n_cells; ++c)
+		offsets[c + 1] += offsets[c];
+
+	vector<int> next(offsets.begin(), offsets.end() - 1);
+	order.resize(offsets[n_cells]);
+
+	int n_moved = 0;
+	for (int p = 0; p < n_sim; ++p) {
+		int c = cells[p];
+		if (c < 0) continue;
+		if (next[c] != p) ++n_moved;
+		order[next[c]++] = p;
 	}
 
+	return n_moved;
+}
+
+const Species::CellIndex &Species::get_cell_index()
+{
+	if (!cell_index_valid) {
+		bin_particles(cell_index.order, cell_index.offsets);
+		cell_index_valid = true;
+	}
+
+	return cell_index;
+}
+
+template <int N, typename Kernel>
+void Species::deposit(double *f, Kernel &&kernel)
+{
+	DepositionScheme scheme = deposition.select_scheme(N);
+
+	const int *order = nullptr, *offsets = nullptr;
+	if (scheme == DepositionScheme::ColoredTiles) {
+		if (sorted) {
+			offsets = cell_offsets.data();
+		} else {
+			const CellIndex &index = get_cell_index();
+			order = index.order.data();
+			offsets = index.offsets.data();
+		}
+	}
+
+	deposition.deposit<N>(scheme, f, get_sim_count(), kernel, order, offsets);
+}
+
+void Species::calc_number_density(bool sample_moments)
+{
+	const double *w_mp = particles.w_mp_data();
+
+	if (sample_moments) {
+		this->sample_moments();
+		for (int u = 0; u < domain.n_nodes; ++u)
+			n(u) = get_moment(u, MN);
+	} else {
+		n.setZero();
+		deposit<1>(n.data(), [&](int p, Vector3i &c, Vector3d &d, double *val) {
+			if (w_mp[p] <= 0) return false;
+			locate(p, c, d);
+			moment_values<1>(p, val);
+			return true;
+		});
+	}
+
+	synchronize_number_density();
+}
+
+void Species::synchronize_number_density()
+{
+
 	const int &ni = domain.ni;
 	const int &nj = domain.nj;
 	const int &nk = domain.nk;
@@ -200,7 +635,7 @@ void Species::calc_number_density()
 	}
 
 	if (domain.is_periodic(Zmin)) {
-		for (int i = 0; i < nj; ++i) {
+		for (int i = 0; i < ni; ++i) {
 			for (int j = 0; j < nj; ++j) {
 				n(domain.at(i, j, 0)) = 0.5*(n(domain.at(i, j, 0))
 						+ n(domain.at(i, j, nk - 1)));
@@ -217,26 +652,21 @@ void Species::calc_number_density()
 
 void Species::sample_moments()
 {
-	n_sum.setZero();
-	nv_sum.setZero();
-	nuu_sum.setZero();
-	nvv_sum.setZero();
-	nww_sum.setZero();
-
-	for(const Particle &p : particles) {
-		Vector3d l = domain.x_to_l(p.x);
-		domain.scatter(n_sum,   l, p.w_mp);
-		domain.scatter(nv_sum,  l, p.w_mp*p.v);
-		domain.scatter(nuu_sum, l, p.w_mp*p.v(X)*p.v(X));
-		domain.scatter(nvv_sum, l, p.w_mp*p.v(Y)*p.v(Y));
-		domain.scatter(nww_sum, l, p.w_mp*p.v(Z)*p.v(Z));
-	}
+	const double *w_mp = particles.w_mp_data();
+
+	moments.assign(N_MOMENTS*domain.n_nodes, 0.0);
+	deposit<N_MOMENTS>(moments.data(), [&](int p, Vector3i &c, Vector3d &d, double *val) {
+		if (w_mp[p] <= 0) return false;
+		locate(p, c, d);
+		moment_values<N_MOMENTS>(p, val);
+		return true;
+	});
 }
 
 void Species::calc_gas_properties()
 {
 	for (int u = 0; u < domain.n_nodes; ++u) {
-		double n_u = n_sum(u);
+		double n_u = get_moment(u, MN);
 
 		if (n_u <= 0) {
 			v_stream.row(u).setZero();
@@ -244,15 +674,16 @@ void Species::calc_gas_properties()
 			continue;
 		}
 
-		v_stream.row(u) = nv_sum.row(u)/n_u;
+		v_stream.row(u) << get_moment(u, MNU)/n_u, get_moment(u, MNV)/n_u,
+			get_moment(u, MNW)/n_u;
 
 		double u_mean = v_stream(u, X);
 		double v_mean = v_stream(u, Y);
 		double w_mean = v_stream(u, Z);
 
-		double u2_mean = nuu_sum(u)/n_u;
-		double v2_mean = nvv_sum(u)/n_u;
-		double w2_mean = nww_sum(u)/n_u;
+		double u2_mean = get_moment(u, MNUU)/n_u;
+		double v2_mean = get_moment(u, MNVV)/n_u;
+		double w2_mean = get_moment(u, MNWW)/n_u;
 
 		double uu = u2_mean - u_mean*u_mean;
 		double vv = v2_mean - v_mean*v_mean;
@@ -264,9 +695,8 @@ void Species::calc_gas_properties()
 
 void Species::calc_macroparticle_count()
 {
-	mp_count.setZero();
-	for(const Particle &p : particles) {
-		int c = domain.x_to_c(p.x);
-		mp_count(c) += 1;
-	}
+	const vector<int> &offsets = get_cell_index().offsets;
+
+	for (int c = 0; c < domain.n_cells; ++c)
+		mp_count(c) = offsets[c + 1] - offsets[c];
 }
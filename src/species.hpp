@@ -7,26 +7,19 @@
 #include "const.hpp"
 #include "domain.hpp"
 #include "random.hpp"
-
-struct Particle {
-	using Vector3d = Eigen::Vector3d;
-
-	Particle(const Vector3d &x, const Vector3d &v, double dt, double w_mp) :
-		x{x}, v{v}, dt{dt}, w_mp{w_mp} {}
-
-	Vector3d x;		/* [m] particle position */
-	Vector3d v;		/* [m/s] particle velocity */
-	double dt;		/* [s] particle time step */
-	double w_mp;	/* [-] macro particle weight */
-};
+#include "particles.hpp"
+#include "deposition.hpp"
+#include "simd.hpp"
 
 class Species {
 	public:
+		using Vector3i = Eigen::Vector3i;
 		using Vector3d = Eigen::Vector3d;
 		using VectorXd = Eigen::VectorXd;
 		using MatrixXd = Eigen::MatrixXd;
 
-		Species(std::string name, double m, double q, double w_mp0, Domain &domain);
+		Species(std::string name, double m, double q, double w_mp0, Domain &domain,
+				Precision precision = Precision::Double);
 
 		int get_sim_count() const {return (int)particles.size();}
 
@@ -65,12 +58,55 @@ class Species {
 
 		void push_particles_leapfrog();
 
+		/* push_particles_leapfrog, remove_dead_particles and
+		 * calc_number_density(sample_moments) in a single pass */
+		void push_particles_and_deposit(bool sample_moments = false);
+
 		void remove_dead_particles();
 
-		void calc_number_density();
+		void set_position_encoding(PositionEncoding encoding);
+
+		void set_sorting(int interval, bool adaptive = false);
+
+		void sort_particles();
+
+		bool is_sorted() const {return sorted;}
+
+		const std::vector<int> &get_cell_offsets() const {return cell_offsets;}
+
+		/* particles grouped by cell, the particles of cell c are order[k] for
+		 * offsets[c] <= k < offsets[c + 1], dead particles are left out */
+		struct CellIndex {
+			std::vector<int> order;
+			std::vector<int> offsets;
+		};
+
+		/* cell index of the current positions, it is built at most once
+		 * between two pushes from the cells push_particles_and_deposit
+		 * records on the way and shared by the interactions, the deposition
+		 * and the diagnostics */
+		const CellIndex &get_cell_index();
+
+		/* cell index of particle p */
+		int get_cell(int p) const {
+			if (particles.is_cell_relative())
+				return domain.cell_at(particles.c_data(X)[p],
+						particles.c_data(Y)[p], particles.c_data(Z)[p]);
+			return domain.x_to_c(particles.x(p));
+		}
+
+		/* with sample_moments the moments are sampled in the same pass and
+		 * the density is taken from them */
+		void calc_number_density(bool sample_moments = false);
 
 		void sample_moments();
 
+		/* components of the sampled moments, interleaved per node */
+		enum Moment {MN, MNU, MNV, MNW, MNUU, MNVV, MNWW, MNUV, MNUW, MNVW, N_MOMENTS};
+
+		/* weighted sum of moment m over the particles around node u */
+		double get_moment(int u, Moment m) const {return moments[N_MOMENTS*u + m];}
+
 		void calc_gas_properties();
 
 		void calc_macroparticle_count();
@@ -82,7 +118,8 @@ class Species {
 		const double q; 	/* [C] species charge */
 		const double w_mp0;	/* [-] default macro particle weight */
 
-		std::vector<Particle> particles;
+		Particles particles;
+		Deposition deposition;
 		VectorXd n;			/* [1/m^3] number density */
 		VectorXd n_mean;	/* [1/m^3] time averaged number density */
 		VectorXd T;
@@ -90,10 +127,75 @@ class Species {
 		MatrixXd v_stream;
 
 	private:
+		/* cell index c and offset d inside the cell of particle p */
+		void locate(int p, Vector3i &c, Vector3d &d) const {
+			if (particles.is_cell_relative()) {
+				c = particles.cell(p);
+				d = particles.offset(p);
+			} else {
+				Vector3d l = domain.x_to_l(particles.x(p));
+				c = domain.l_to_c(l);
+				d = l - c.cast<double>();
+			}
+		}
+
+		void move_particle(Particle &p) const;
+
+		void round_inside(int p);
+
+		/* call f(push), push(begin, end) advances the particles [begin, end)
+		 * by one time step */
+		template <typename F>
+		void visit_pusher(F &&f);
+
+		template <typename Real>
+		auto cell_relative_pusher();
+
+		template <int N>
+		void push_and_deposit(double *f);
+
+		/* weighted moments of particle p, the density for N = 1 */
+		template <int N>
+		void moment_values(int p, double *val) const;
+
+		/* periodic synchronization, volume and time averaging of n */
+		void synchronize_number_density();
+
+		/* counting sort of the particle indices by cell, returns the number of
+		 * particles that are not in place */
+		int bin_particles(std::vector<int> &order, std::vector<int> &offsets);
+
+		/* the particles changed, the recorded cells and the index are stale */
+		void invalidate_cells() {
+			sorted = false;
+			cells_valid = false;
+			cell_index_valid = false;
+		}
+
+		/* deposit N components per node into f with the deposition engine */
+		template <int N, typename Kernel>
+		void deposit(double *f, Kernel &&kernel);
+
+		/* particles handed to the push kernels at once */
+		static constexpr int push_chunk = 256;
+
 		double mu = 0.0;	/* time averaging factor */
 
-		VectorXd n_sum, nuu_sum, nvv_sum, nww_sum;
-		MatrixXd nv_sum;
+		/* cell sorting, particles of cell c are [cell_offsets[c], cell_offsets[c + 1])
+		 * as long as sorted is true */
+		int sort_interval = 0, sort_interval_min = 1, sort_interval_max = 1;
+		int steps_since_sort = 0;
+		bool adaptive_sorting = false, sorted = false;
+		std::vector<int> cell_offsets, sort_order;
+
+		/* cell of every particle, -1 if dead, valid as long as cells_valid */
+		std::vector<int> cells;
+		bool cells_valid = false;
+
+		CellIndex cell_index;
+		bool cell_index_valid = false;
+
+		AlignedVector<double> moments;
 
 		Domain &domain;
 };
@@ -0,0 +1,202 @@
+#include "spectral.hpp"
+#include "const.hpp"
+
+using namespace std;
+using namespace Eigen;
+using namespace Const;
+
+bool SpectralSolver::setup(const SpMat &A, const Domain &domain)
+{
+	grid.clear();
+
+	const int nn[3] = {domain.ni, domain.nj, domain.nk};
+	const BoundarySide side_min[3] = {Xmin, Ymin, Zmin};
+	const BoundarySide side_max[3] = {Xmax, Ymax, Zmax};
+
+	for (int dim = 0; dim < 3; ++dim) {
+		if (domain.is_periodic(side_min[dim]) != domain.is_periodic(side_max[dim]))
+			return false;
+
+		/* the last node of a periodic direction repeats the first one */
+		periodic[dim] = domain.is_periodic(side_min[dim]);
+		n[dim] = periodic[dim] ? nn[dim] - 1 : nn[dim] - 2;
+		offset[dim] = periodic[dim] ? 0 : 1;
+
+		if (n[dim] < 1)
+			return false;
+	}
+
+	/* the faces of the non periodic directions have to be Dirichlet nodes,
+	 * i.e. identity rows, everywhere else the Laplacian applies */
+	const Vector3d del_x_2q = 1.0/domain.get_del_x().array().pow(2);
+	double diag = -2*del_x_2q.sum();
+
+	/* with two nodes per periodic direction each node is its own neighbor */
+	for (int dim = 0; dim < 3; ++dim) {
+		if (periodic[dim] && n[dim] == 1)
+			diag += del_x_2q(dim);
+	}
+
+	SparseMatrix<double, RowMajor> A_row = A;
+	fixed.assign(domain.n_nodes, false);
+
+	for (int k = 0; k < nn[2]; ++k) {
+		for (int j = 0; j < nn[1]; ++j) {
+			for (int i = 0; i < nn[0]; ++i) {
+				const int idx[3] = {i, j, k};
+				bool face = false;
+				for (int dim = 0; dim < 3; ++dim)
+					face |= !periodic[dim] && (idx[dim] == 0 || idx[dim] == nn[dim] - 1);
+
+				int u = domain.at(i,j,k);
+				SparseMatrix<double, RowMajor>::InnerIterator it(A_row, u);
+				fixed[u] = it && it.col() == u && it.value() == 1 && !(++it);
+
+				if (face != fixed[u] || (!face && A.coeff(u, u) != diag))
+					return false;
+			}
+		}
+	}
+
+	/* eigenvalues of the 1D second differences */
+	for (int dim = 0; dim < 3; ++dim) {
+		eigenvalues[dim].resize(n[dim]);
+		for (int m = 0; m < n[dim]; ++m) {
+			double theta = periodic[dim] ? 2*PI*m/n[dim] : PI*(m + 1)/(n[dim] + 1);
+			eigenvalues[dim][m] = del_x_2q(dim)*(2*cos(theta) - 2);
+		}
+	}
+
+	this->A = &A;
+	this->domain = &domain;
+	grid.assign(n[0]*n[1]*n[2], 0);
+
+	/* plan the transforms of all line lengths */
+	for (int dim = 0; dim < 3; ++dim) {
+		if (periodic[dim] && n[dim] == 1)
+			continue;
+
+		line.assign(periodic[dim] ? n[dim] : 2*(n[dim] + 1), 0);
+		fft.fwd(line_hat, line);
+		fft.inv(line, line_hat);
+	}
+
+	return true;
+}
+
+void SpectralSolver::transform(int dim, bool forward) const
+{
+	const int stride[3] = {1, n[0], n[0]*n[1]};
+
+	/* the two directions across the lines */
+	const int a = (dim + 1)%3, b = (dim + 2)%3;
+	const int len = n[dim];
+
+	for (int q_b = 0; q_b < n[b]; ++q_b) {
+		for (int q_a = 0; q_a < n[a]; ++q_a) {
+			Complex *f = grid.data() + q_a*stride[a] + q_b*stride[b];
+
+			/* a single mode is its own transform */
+			if (periodic[dim] && len == 1) {
+				continue;
+
+			} else if (periodic[dim]) {
+				line.resize(len);
+				for (int q = 0; q < len; ++q)
+					line[q] = f[q*stride[dim]];
+
+				if (forward)
+					fft.fwd(line_hat, line);
+				else
+					fft.inv(line_hat, line);
+
+				for (int q = 0; q < len; ++q)
+					f[q*stride[dim]] = line_hat[q];
+
+			/* DST-I of length len from the FFT of the odd extension of length
+			 * 2(len + 1), the DST-I is its own inverse up to 2/(len + 1) */
+			} else {
+				const int L = 2*(len + 1);
+				line.assign(L, 0);
+				for (int q = 0; q < len; ++q) {
+					line[q + 1] = f[q*stride[dim]];
+					line[L - 1 - q] = -f[q*stride[dim]];
+				}
+
+				fft.fwd(line_hat, line);
+
+				Complex scale(0, forward ? 0.5 : 1.0/(len + 1));
+				for (int q = 0; q < len; ++q)
+					f[q*stride[dim]] = scale*line_hat[q + 1];
+			}
+		}
+	}
+}
+
+void SpectralSolver::solve(const VectorXd &b, VectorXd &x) const
+{
+	const Domain &d = *domain;
+
+	/* move the Dirichlet values to the right hand side */
+	VectorXd x_b = VectorXd::Zero(d.n_nodes);
+	for (int u = 0; u < d.n_nodes; ++u) {
+		if (fixed[u])
+			x_b(u) = b(u);
+	}
+
+	VectorXd r = b - (*A)*x_b;
+
+	for (int k = 0; k < n[2]; ++k) {
+		for (int j = 0; j < n[1]; ++j) {
+			for (int i = 0; i < n[0]; ++i)
+				grid[i + n[0]*(j + n[1]*k)] = r(d.at(i + offset[0], j + offset[1], k + offset[2]));
+		}
+	}
+
+	for (int dim = 0; dim < 3; ++dim)
+		transform(dim, true);
+
+	for (int k = 0; k < n[2]; ++k) {
+		for (int j = 0; j < n[1]; ++j) {
+			for (int i = 0; i < n[0]; ++i) {
+				double lambda = eigenvalues[0][i] + eigenvalues[1][j] + eigenvalues[2][k];
+				Complex &g = grid[i + n[0]*(j + n[1]*k)];
+
+				/* the constant mode of a fully periodic box is left out */
+				g = lambda != 0 ? g/lambda : 0;
+			}
+		}
+	}
+
+	for (int dim = 0; dim < 3; ++dim)
+		transform(dim, false);
+
+	x = x_b;
+	for (int k = 0; k < n[2]; ++k) {
+		for (int j = 0; j < n[1]; ++j) {
+			for (int i = 0; i < n[0]; ++i)
+				x(d.at(i + offset[0], j + offset[1], k + offset[2])) = grid[i + n[0]*(j + n[1]*k)].real();
+		}
+	}
+
+	/* last nodes of the periodic directions */
+	const int nn[3] = {d.ni, d.nj, d.nk};
+	for (int k = 0; k < nn[2]; ++k) {
+		for (int j = 0; j < nn[1]; ++j) {
+			for (int i = 0; i < nn[0]; ++i) {
+				int idx[3] = {i, j, k};
+				bool copy = false;
+				for (int dim = 0; dim < 3; ++dim) {
+					if (periodic[dim] && idx[dim] == nn[dim] - 1) {
+						idx[dim] = 0;
+						copy = true;
+					}
+				}
+
+				int u = d.at(i,j,k);
+				if (copy && !fixed[u])
+					x(u) = x(d.at(idx[0], idx[1], idx[2]));
+			}
+		}
+	}
+}
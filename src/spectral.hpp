@@ -0,0 +1,51 @@
+#ifndef SPECTRAL_HPP
+#define SPECTRAL_HPP
+
+#include <vector>
+#include <complex>
+#include <Eigen/Eigen>
+#include <unsupported/Eigen/FFT>
+#include "domain.hpp"
+
+/* direct solver for the field equations on boxes whose faces are either
+ * periodic or entirely Dirichlet, the Laplacian is diagonalized by a
+ * discrete Fourier transform along the periodic directions and a discrete
+ * sine transform (DST-I, via an odd extension) along the Dirichlet ones
+ *
+ * the Dirichlet values may vary over a face, they are moved into the right
+ * hand side, the nodes of a periodic face copy their partner on the opposite
+ * face, for a fully periodic box the solution with zero mean is returned */
+class SpectralSolver {
+	public:
+		using SpMat = Eigen::SparseMatrix<double>;
+		using VectorXd = Eigen::VectorXd;
+		using Complex = std::complex<double>;
+
+		/* check that the operator A assembled for domain can be solved
+		 * spectrally and plan the transforms, returns false otherwise */
+		bool setup(const SpMat &A, const Domain &domain);
+
+		bool is_setup() const {return !grid.empty();}
+
+		/* solve A x = b */
+		void solve(const VectorXd &b, VectorXd &x) const;
+
+	private:
+		void transform(int dim, bool forward) const;
+
+		const SpMat *A = nullptr;
+		const Domain *domain = nullptr;
+
+		bool periodic[3];
+		int n[3];			/* unknowns per direction */
+		int offset[3];		/* node index of the first unknown */
+
+		std::vector<double> eigenvalues[3];
+		std::vector<bool> fixed;	/* nodes with a Dirichlet value */
+
+		mutable Eigen::FFT<double> fft;
+		mutable std::vector<Complex> grid;
+		mutable std::vector<Complex> line, line_hat;
+};
+
+#endif
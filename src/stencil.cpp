@@ -0,0 +1,78 @@
+#include "stencil.hpp"
+
+using namespace std;
+using namespace Eigen;
+
+void StencilOperator::setup(const Domain &domain, const SpMat &A)
+{
+	ni = domain.ni;
+	nj = domain.nj;
+	nk = domain.nk;
+
+	Vector3d del_x_2q = 1.0/domain.get_del_x().array().pow(2);
+	c[0] = -2*del_x_2q.sum();
+	c[1] = del_x_2q(X);
+	c[2] = del_x_2q(Y);
+	c[3] = del_x_2q(Z);
+
+	RowSpMat A_row = A;
+	vector<Triplet<double>> coeffs;
+
+	face_nodes.clear();
+	for (int k = 0; k < nk; ++k) {
+		for (int j = 0; j < nj; ++j) {
+			for (int i = 0; i < ni; ++i) {
+				if (is_interior(domain, i, j, k))
+					continue;
+
+				int u = domain.at(i,j,k);
+				for (RowSpMat::InnerIterator it(A_row, u); it; ++it)
+					coeffs.push_back(Triplet<double>(face_nodes.size(), it.col(), it.value()));
+
+				face_nodes.push_back(u);
+			}
+		}
+	}
+
+	face_rows.resize(face_nodes.size(), domain.n_nodes);
+	face_rows.setFromTriplets(coeffs.begin(), coeffs.end());
+}
+
+void StencilOperator::apply(const VectorXd &x, VectorXd &y, [[maybe_unused]] int n_threads) const
+{
+	y.resize(x.size());
+
+	const StencilKernel kernel = get_stencil_kernel();
+
+	#pragma omp parallel for num_threads(n_threads) schedule(static) if(n_threads > 1)
+	for (int k = 1; k < nk - 1; ++k) {
+		for (int j = 1; j < nj - 1; ++j) {
+			int u = 1 + j*ni + k*ni*nj;
+			kernel(x.data() + u, y.data() + u, ni - 2, ni, ni*nj, c);
+		}
+	}
+
+	#pragma omp parallel for num_threads(n_threads) schedule(static) if(n_threads > 1)
+	for (int r = 0; r < (int)face_nodes.size(); ++r) {
+		double f = 0;
+		for (RowSpMat::InnerIterator it(face_rows, r); it; ++it)
+			f += it.value()*x(it.col());
+		y(face_nodes[r]) = f;
+	}
+}
+
+StencilOperator::VectorXd StencilOperator::diagonal() const
+{
+	VectorXd diag = VectorXd::Constant(ni*nj*nk, c[0]);
+
+	for (int r = 0; r < (int)face_nodes.size(); ++r)
+		diag(face_nodes[r]) = face_rows.coeff(r, face_nodes[r]);
+
+	return diag;
+}
+
+size_t StencilOperator::memory() const
+{
+	return face_rows.nonZeros()*(sizeof(double) + sizeof(int))
+		+ (face_rows.outerSize() + 1)*sizeof(int) + face_nodes.size()*sizeof(int);
+}
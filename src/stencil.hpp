@@ -0,0 +1,49 @@
+#ifndef STENCIL_HPP
+#define STENCIL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <Eigen/Eigen>
+#include "domain.hpp"
+#include "simd.hpp"
+
+/* matrix-free form of the field operator of Solver
+ *
+ * the nodes off the faces of the mesh all share the 7 point Laplacian, it is
+ * applied with the vectorized stencil kernel line by line along x, only the
+ * rows of the face nodes, i.e. the boundary conditions and the periodic
+ * wraps, are stored as sparse rows, so the memory no longer grows with the
+ * number of interior nodes */
+class StencilOperator {
+	public:
+		using SpMat = Eigen::SparseMatrix<double>;
+		using RowSpMat = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+		using VectorXd = Eigen::VectorXd;
+
+		/* true for the nodes the stencil applies to */
+		static bool is_interior(const Domain &domain, int i, int j, int k) {
+			return 0 < i && i < domain.ni - 1 && 0 < j && j < domain.nj - 1
+				&& 0 < k && k < domain.nk - 1;
+		}
+
+		/* A holds the assembled rows of the face nodes, the rows of the
+		 * interior nodes are ignored */
+		void setup(const Domain &domain, const SpMat &A);
+
+		/* y = A x, on n_threads threads */
+		void apply(const VectorXd &x, VectorXd &y, int n_threads = 1) const;
+
+		VectorXd diagonal() const;
+
+		/* [B] memory of the operator */
+		std::size_t memory() const;
+
+	private:
+		int ni = 0, nj = 0, nk = 0;
+		double c[4];			/* center, x, y and z coefficients */
+
+		std::vector<int> face_nodes;
+		RowSpMat face_rows;		/* row r belongs to face_nodes[r] */
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <Eigen/Dense>
+#include "const.hpp"
+#include "domain.hpp"
+#include "solver.hpp"
+
+using namespace std;
+using namespace Const;
+using namespace Eigen;
+using PBC = ParticleBCtype;
+using FBC = FieldBCtype;
+
+/* geometry of test/lens_*.cpp with the mesh refined refine times, the lens is
+ * electrode 0 if electrode is set */
+unique_ptr<Domain> make_domain(int refine, double phi_l, bool electrode)
+{
+	unique_ptr<Domain> domain = make_unique<Domain>("test/simulation/bench_electrodes",
+			60*refine + 1, 20*refine + 1, 20*refine + 1);
+	domain->set_dimensions({0.0, -0.05, -0.05}, {0.3, 0.05, 0.05});
+
+	auto lense = [](double x, double, double){
+		return (0.1 <= x ? (x <= 0.2 ? true : false) : false); };
+
+	domain->set_bc_at(Xmin, BC(PBC::Open,     FBC::Neumann));
+	domain->set_bc_at(Xmax, BC(PBC::Open,     FBC::Neumann));
+	for (BoundarySide face : {Ymin, Ymax, Zmin, Zmax}) {
+		BC lens(PBC::Specular, FBC::Dirichlet, phi_l, lense);
+		if (electrode)
+			lens.set_electrode(0);
+
+		domain->set_bc_at(face, BC(PBC::Specular, FBC::Dirichlet));
+		domain->set_bc_at(face, lens);
+	}
+
+	/* beam of radius 0.02 m */
+	const double n = 1e11;
+	Vector3d del_x = domain->get_del_x();
+	for (int i = 0; i < domain->ni; ++i) {
+		for (int j = 0; j < domain->nj; ++j) {
+			for (int k = 0; k < domain->nk; ++k) {
+				Vector3d x = domain->get_x_min() + Vector3d(i, j, k).cwiseProduct(del_x);
+				domain->rho(domain->at(i,j,k)) =
+					QE*n*exp(-(x(Y)*x(Y) + x(Z)*x(Z))/(0.02*0.02));
+			}
+		}
+	}
+
+	return domain;
+}
+
+/* sweep of the lens voltage, once with a new solver for every voltage and
+ * once with the superposition of the electrode solution, every solver gets
+ * its own domain since Solver reorders the boundary conditions of the domain */
+int main()
+{
+	const vector<double> phi_l = {-100, -50, 0, 50, 100}; /* [V] */
+
+	cout << "solver,nodes,mode,setup time,sweep time,max difference" << endl;
+
+	for (SolverType type : {SolverType::Direct, SolverType::BiCGSTAB}) {
+		const double tol = 1e-10;
+
+		/* rebuild the solver for every voltage */
+		vector<VectorXd> reference;
+		chrono::duration<double> rebuild(0);
+		int n_nodes = 0;
+		for (double V : phi_l) {
+			unique_ptr<Domain> domain = make_domain(1, V, false);
+			n_nodes = domain->n_nodes;
+
+			auto start = chrono::high_resolution_clock::now();
+			Solver solver(*domain, 100000, tol, type);
+			solver.calc_potential();
+			rebuild += chrono::high_resolution_clock::now() - start;
+
+			reference.push_back(domain->phi);
+		}
+
+		cout << solver_type_name(type) << "," << n_nodes << ",rebuild,0,"
+			 << rebuild.count() << ",0" << endl;
+
+		/* one solver, only the voltage of the electrode changes */
+		unique_ptr<Domain> domain = make_domain(1, phi_l[0], true);
+
+		auto start = chrono::high_resolution_clock::now();
+		Solver solver(*domain, 100000, tol, type);
+		chrono::duration<double> setup = chrono::high_resolution_clock::now() - start;
+
+		double difference = 0;
+		start = chrono::high_resolution_clock::now();
+		for (int s = 0; s < (int)phi_l.size(); ++s) {
+			solver.set_electrode_voltage(0, phi_l[s]);
+			solver.calc_potential();
+			difference = max(difference, (domain->phi - reference[s]).cwiseAbs().maxCoeff());
+		}
+		chrono::duration<double> sweep = chrono::high_resolution_clock::now() - start;
+
+		cout << solver_type_name(type) << "," << n_nodes << ",superposition,"
+			 << setup.count() << "," << sweep.count() << "," << difference << endl;
+	}
+}
@@ -0,0 +1,69 @@
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "const.hpp"
+#include "domain.hpp"
+#include "random.hpp"
+
+using namespace std;
+using namespace Const;
+using namespace Eigen;
+
+/* throughput of Domain::gather_E for the different field layouts, with the
+ * particles in random order and sorted by cell */
+int main()
+{
+	Vector3d x_min = {0.0, 0.0, 0.0};
+	Vector3d x_max = {1.0, 1.0, 1.0};
+
+	Domain domain("test/simulation/bench_gather", 101, 101, 101);
+	domain.set_dimensions(x_min, x_max);
+	domain.E.setRandom();
+
+	const int n_particles = 4000000;
+	const int n_repeat = 5;
+
+	rng.get_gen().seed(1);
+	vector<Vector3d> l(n_particles);
+	for (auto &l_p : l)
+		l_p = (x_max - x_min).cwiseProduct(Vector3d(rng(), rng(), rng()))
+			.cwiseQuotient(domain.get_del_x());
+
+	vector<Vector3d> l_sorted(l);
+	sort(l_sorted.begin(), l_sorted.end(), [&](const Vector3d &a, const Vector3d &b) {
+			return domain.x_to_c(x_min + a.cwiseProduct(domain.get_del_x()))
+				< domain.x_to_c(x_min + b.cwiseProduct(domain.get_del_x()));});
+
+	vector<Vector3d> E_ref(n_particles);
+	for (int p = 0; p < n_particles; ++p)
+		E_ref[p] = domain.gather(domain.E, l[p]);
+
+	cout << "layout,order,gathers per second,max deviation" << endl;
+
+	for (FieldLayout layout : {FieldLayout::ColumnMajor, FieldLayout::Interleaved,
+			FieldLayout::CellCache}) {
+		domain.set_field_layout(layout);
+
+		double deviation = 0;
+		for (int p = 0; p < n_particles; ++p)
+			deviation = max(deviation, (domain.gather_E(l[p]) - E_ref[p]).norm());
+
+		for (bool sorted : {false, true}) {
+			const vector<Vector3d> &l_p = sorted ? l_sorted : l;
+
+			Vector3d E_sum = Vector3d::Zero();
+			auto start = chrono::high_resolution_clock::now();
+			for (int r = 0; r < n_repeat; ++r) {
+				for (int p = 0; p < n_particles; ++p)
+					E_sum += domain.gather_E(l_p[p]);
+			}
+			chrono::duration<double> wtime = chrono::high_resolution_clock::now() - start;
+
+			const char *name[] = {"column major", "interleaved", "cell cache"};
+			cout << name[(int)layout] << "," << (sorted ? "sorted" : "random") << ","
+				 << n_repeat*n_particles/wtime.count() << "," << deviation
+				 << (E_sum.hasNaN() ? " (nan)" : "") << endl;
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#include <vector>
+#include <chrono>
+#include <Eigen/Dense>
+#include "const.hpp"
+#include "domain.hpp"
+#include "species.hpp"
+#include "solver.hpp"
+#include "simd.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+using namespace Const;
+using namespace Eigen;
+using PBC = ParticleBCtype;
+using FBC = FieldBCtype;
+
+/* strong scaling of Species::push_particles_leapfrog on the lens geometry
+ * for every vector instruction set the cpu supports, build with OPENMP = on,
+ * e.g. make OPENMP=on TEST=bench_push */
+int main()
+{
+	Vector3d x_min = {0.0, -0.05, -0.05};
+	Vector3d x_max = {0.3,  0.05,  0.05};
+
+	Domain domain("test/simulation/bench_push", 61, 21, 21);
+	domain.set_dimensions(x_min, x_max);
+	domain.set_time_step(1e-9);
+	domain.set_iter_max(0);
+
+	double phi_l = -100; /* [V] */
+
+	/* diffuse walls, so that the thread local random streams are used */
+	domain.set_bc_at(Xmin, BC(PBC::Specular, FBC::Neumann));
+	domain.set_bc_at(Xmax, BC(PBC::Specular, FBC::Neumann));
+	domain.set_bc_at(Ymin, BC(PBC::Diffuse, 300, 1, FBC::Dirichlet, 0,
+				[](double, double, double){ return true; }));
+	domain.set_bc_at(Ymax, BC(PBC::Diffuse, 300, 1, FBC::Dirichlet, 0,
+				[](double, double, double){ return true; }));
+	domain.set_bc_at(Zmin, BC(PBC::Specular, FBC::Dirichlet));
+	domain.set_bc_at(Zmax, BC(PBC::Specular, FBC::Dirichlet));
+
+	auto lense = [](double x, double, double){
+		return (0.1 <= x ? (x <= 0.2 ? true : false) : false); };
+	domain.set_bc_at(Ymin, BC(PBC::Diffuse, 300, 1, FBC::Dirichlet, phi_l, lense));
+	domain.set_bc_at(Ymax, BC(PBC::Diffuse, 300, 1, FBC::Dirichlet, phi_l, lense));
+	domain.set_bc_at(Zmin, BC(PBC::Specular, FBC::Dirichlet, phi_l, lense));
+	domain.set_bc_at(Zmax, BC(PBC::Specular, FBC::Dirichlet, phi_l, lense));
+
+	vector<Species> species;
+	species.push_back(Species("e-", ME, -QE, 2.5e2, domain));
+
+	const double n = 1e11;
+	const double T = 10*EvToK;
+
+	species[0].add_warm_box(x_min, x_max, n, {1e5, 0, 0}, T);
+
+	Solver solver(domain, 10000, 1e-4);
+	solver.calc_potential();
+	solver.calc_electric_field();
+
+	const int n_steps = 20;
+
+	int n_threads_max = 1;
+#ifdef _OPENMP
+	n_threads_max = 64;
+	cout << "available processors: " << omp_get_num_procs() << endl;
+#endif
+
+	cout << "particles: " << species[0].get_sim_count() << endl;
+	cout << "isa,threads,time per step [s],particles per second,speedup" << endl;
+
+	/* the speedup is relative to the scalar push on one thread */
+	double t_1 = 0;
+	for (int isa = 0; isa <= (int)detect_simd_isa(); ++isa)
+	for (int n_threads = 1; n_threads <= n_threads_max; n_threads *= 2) {
+		set_simd_isa((SimdIsa)isa);
+#ifdef _OPENMP
+		omp_set_num_threads(n_threads);
+#endif
+
+		/* warm up */
+		species[0].push_particles_leapfrog();
+		species[0].remove_dead_particles();
+
+		auto start = chrono::high_resolution_clock::now();
+		for (int step = 0; step < n_steps; ++step) {
+			species[0].push_particles_leapfrog();
+			species[0].remove_dead_particles();
+		}
+		chrono::duration<double> wtime = chrono::high_resolution_clock::now() - start;
+
+		double t_step = wtime.count()/n_steps;
+		if (t_1 == 0) t_1 = t_step;
+
+		cout << simd_isa_name(get_simd_isa()) << "," << n_threads << "," << t_step << ","
+			 << species[0].get_sim_count()/t_step << "," << t_1/t_step << endl;
+	}
+}
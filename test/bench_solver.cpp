@@ -0,0 +1,116 @@
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <Eigen/Dense>
+#include "const.hpp"
+#include "domain.hpp"
+#include "solver.hpp"
+
+using namespace std;
+using namespace Const;
+using namespace Eigen;
+using PBC = ParticleBCtype;
+using FBC = FieldBCtype;
+
+enum Case {Lens, Periodic, Sheath};
+
+/* geometries of test/lens_*.cpp, test/periodic.cpp and test/sheath.cpp with
+ * the mesh refined refine times */
+unique_ptr<Domain> make_domain(Case c, int refine)
+{
+	unique_ptr<Domain> domain;
+
+	if (c == Sheath) {
+		domain = make_unique<Domain>("test/simulation/bench_solver", 20*refine + 1, 2, 2);
+		domain->set_dimensions({0.00, -0.00075, -0.00075}, {0.03, 0.00075, 0.00075});
+	} else {
+		domain = make_unique<Domain>("test/simulation/bench_solver", 60*refine + 1,
+				20*refine + 1, 20*refine + 1);
+		domain->set_dimensions({0.0, -0.05, -0.05}, {0.3, 0.05, 0.05});
+	}
+
+	if (c == Lens) {
+		double phi_l = -100; /* [V] */
+
+		domain->set_bc_at(Xmin, BC(PBC::Open,     FBC::Neumann));
+		domain->set_bc_at(Xmax, BC(PBC::Open,     FBC::Neumann));
+		domain->set_bc_at(Ymin, BC(PBC::Specular, FBC::Dirichlet));
+		domain->set_bc_at(Ymax, BC(PBC::Specular, FBC::Dirichlet));
+		domain->set_bc_at(Zmin, BC(PBC::Specular, FBC::Dirichlet));
+		domain->set_bc_at(Zmax, BC(PBC::Specular, FBC::Dirichlet));
+
+		auto lense = [](double x, double, double){
+			return (0.1 <= x ? (x <= 0.2 ? true : false) : false); };
+		domain->set_bc_at(Ymin, BC(PBC::Specular, FBC::Dirichlet, phi_l, lense));
+		domain->set_bc_at(Ymax, BC(PBC::Specular, FBC::Dirichlet, phi_l, lense));
+		domain->set_bc_at(Zmin, BC(PBC::Specular, FBC::Dirichlet, phi_l, lense));
+		domain->set_bc_at(Zmax, BC(PBC::Specular, FBC::Dirichlet, phi_l, lense));
+
+	} else {
+		domain->set_bc_at(Xmin, BC(PBC::Open,     FBC::Dirichlet));
+		domain->set_bc_at(Xmax, BC(PBC::Open,     FBC::Dirichlet, c == Sheath ? -0.18011 : -1));
+		domain->set_bc_at(Ymin, BC(PBC::Periodic, FBC::Periodic));
+		domain->set_bc_at(Ymax, BC(PBC::Periodic, FBC::Periodic));
+		domain->set_bc_at(Zmin, BC(PBC::Periodic, FBC::Periodic));
+		domain->set_bc_at(Zmax, BC(PBC::Periodic, FBC::Periodic));
+	}
+
+	return domain;
+}
+
+/* setup and solve time of the field solvers with the space charge of a beam
+ * along x, for increasing mesh resolution, every solver gets its own domain
+ * since Solver reorders the boundary conditions of the domain */
+int main()
+{
+	const double n = 1e11;
+
+	cout << "case,solver,nodes,setup time,solve time,iterations,error,operator memory,"
+		 << "factorization memory"
+		 << endl;
+
+	for (Case c : {Lens, Periodic, Sheath}) {
+		for (int refine : c == Sheath ? vector<int>{1, 4, 10} : vector<int>{1, 2, 4}) {
+			for (SolverType type : {SolverType::BiCGSTAB, SolverType::Multigrid,
+					SolverType::MultigridBiCGSTAB, SolverType::FFT, SolverType::MatrixFree,
+					SolverType::CG, SolverType::Direct, SolverType::MixedPrecision}) {
+				unique_ptr<Domain> domain = make_domain(c, refine);
+
+				/* the fill-in of the factors grows too fast on the fine 3D meshes */
+				if (type == SolverType::Direct && domain->n_nodes > 100000)
+					continue;
+
+				/* beam of radius 0.02 m */
+				Vector3d del_x = domain->get_del_x();
+				for (int i = 0; i < domain->ni; ++i) {
+					for (int j = 0; j < domain->nj; ++j) {
+						for (int k = 0; k < domain->nk; ++k) {
+							Vector3d x = domain->get_x_min() + Vector3d(i, j, k).cwiseProduct(del_x);
+							domain->rho(domain->at(i,j,k)) =
+								QE*n*exp(-(x(Y)*x(Y) + x(Z)*x(Z))/(0.02*0.02));
+						}
+					}
+				}
+
+				auto start = chrono::high_resolution_clock::now();
+				Solver solver(*domain, 100000, 1e-6, type);
+				chrono::duration<double> setup = chrono::high_resolution_clock::now() - start;
+
+				/* solvers that are not available for the case */
+				if (solver.get_type() != type)
+					continue;
+
+				start = chrono::high_resolution_clock::now();
+				solver.calc_potential();
+				chrono::duration<double> solve = chrono::high_resolution_clock::now() - start;
+
+				const char *name[] = {"lens", "periodic", "sheath"};
+				cout << name[c] << "," << solver_type_name(type) << ","
+					 << domain->n_nodes << "," << setup.count() << "," << solve.count() << ","
+					 << solver.get_iterations() << "," << solver.get_error() << ","
+					 << solver.get_operator_memory() << ","
+					 << solver.get_factorization_memory() << endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <Eigen/Dense>
+#include "const.hpp"
+#include "domain.hpp"
+#include "solver.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+using namespace Const;
+using namespace Eigen;
+using PBC = ParticleBCtype;
+using FBC = FieldBCtype;
+
+enum Case {Lens, Periodic};
+
+/* geometries of test/lens_*.cpp and test/periodic.cpp with the mesh refined
+ * refine times */
+unique_ptr<Domain> make_domain(Case c, int refine)
+{
+	unique_ptr<Domain> domain = make_unique<Domain>("test/simulation/bench_solver_threads",
+			60*refine + 1, 20*refine + 1, 20*refine + 1);
+	domain->set_dimensions({0.0, -0.05, -0.05}, {0.3, 0.05, 0.05});
+
+	if (c == Lens) {
+		double phi_l = -100; /* [V] */
+
+		auto lense = [](double x, double, double){
+			return (0.1 <= x ? (x <= 0.2 ? true : false) : false); };
+
+		domain->set_bc_at(Xmin, BC(PBC::Open,     FBC::Neumann));
+		domain->set_bc_at(Xmax, BC(PBC::Open,     FBC::Neumann));
+		for (BoundarySide face : {Ymin, Ymax, Zmin, Zmax}) {
+			domain->set_bc_at(face, BC(PBC::Specular, FBC::Dirichlet));
+			domain->set_bc_at(face, BC(PBC::Specular, FBC::Dirichlet, phi_l, lense));
+		}
+	} else {
+		domain->set_bc_at(Xmin, BC(PBC::Open,     FBC::Dirichlet));
+		domain->set_bc_at(Xmax, BC(PBC::Open,     FBC::Dirichlet, -1));
+		for (BoundarySide face : {Ymin, Ymax, Zmin, Zmax})
+			domain->set_bc_at(face, BC(PBC::Periodic, FBC::Periodic));
+	}
+
+	return domain;
+}
+
+/* strong scaling of the field solve alone, the threads of the solver are set
+ * independently of OMP_NUM_THREADS, which only bounds them */
+int main()
+{
+	const double n = 1e11;
+
+	int max_threads = 1;
+#ifdef _OPENMP
+	max_threads = omp_get_max_threads();
+#endif
+
+	/* the summation order of the dot products depends on the number of
+	 * threads, which changes the iteration count of BiCGSTAB a little, the
+	 * speedup is therefore given per iteration */
+	cout << "case,solver,nodes,threads,solve time,iterations,time per iteration,speedup"
+		 << endl;
+
+	for (Case c : {Lens, Periodic}) {
+		for (int refine : {2, 3}) {
+			for (SolverType type : {SolverType::BiCGSTAB, SolverType::MatrixFree}) {
+				double serial = 0;
+
+				for (int threads = 1; threads <= max_threads; threads *= 2) {
+					unique_ptr<Domain> domain = make_domain(c, refine);
+
+					/* beam of radius 0.02 m */
+					Vector3d del_x = domain->get_del_x();
+					for (int i = 0; i < domain->ni; ++i) {
+						for (int j = 0; j < domain->nj; ++j) {
+							for (int k = 0; k < domain->nk; ++k) {
+								Vector3d x = domain->get_x_min() + Vector3d(i, j, k).cwiseProduct(del_x);
+								domain->rho(domain->at(i,j,k)) =
+									QE*n*exp(-(x(Y)*x(Y) + x(Z)*x(Z))/(0.02*0.02));
+							}
+						}
+					}
+
+					Solver solver(*domain, 100000, 1e-6, type);
+					solver.set_threads(threads);
+
+					auto start = chrono::high_resolution_clock::now();
+					solver.calc_potential();
+					chrono::duration<double> solve = chrono::high_resolution_clock::now() - start;
+
+					double per_iteration = solve.count()/max(solver.get_iterations(), 1);
+					if (threads == 1)
+						serial = per_iteration;
+
+					const char *name[] = {"lens", "periodic"};
+					cout << name[c] << "," << solver_type_name(type) << ","
+						 << domain->n_nodes << "," << threads << "," << solve.count() << ","
+						 << solver.get_iterations() << "," << per_iteration << ","
+						 << serial/per_iteration << endl;
+				}
+			}
+		}
+	}
+}
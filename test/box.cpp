@@ -52,8 +52,7 @@ int main()
 		solver.calc_electric_field();
 
 		for(Species &sp : species) {
-			sp.push_particles_leapfrog();
-			sp.calc_number_density();
+			sp.push_particles_and_deposit();
 		}
 
 		if (domain.get_iter()%10 == 0 || domain.is_last_iter()) {
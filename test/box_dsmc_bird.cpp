@@ -49,8 +49,7 @@ int main()
 			interaction->apply(domain.get_time_step());
 
 		for(Species &sp : species) {
-			sp.push_particles_leapfrog();
-			sp.calc_number_density();
+			sp.push_particles_and_deposit();
 		}
 
 		if (domain.get_iter()%50 == 0 || domain.is_last_iter()) {
@@ -61,6 +60,8 @@ int main()
 			}
 
 			domain.print_info(species);
+			for (auto &interaction : interactions)
+				interaction->print_info();
 			domain.write_statistics(species);
 			domain.save_fields(species);
 			domain.save_particles(species, 1000);
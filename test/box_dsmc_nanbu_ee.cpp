@@ -17,7 +17,9 @@ const double Te = 1.5*EvToK;					/* [K] */
 const double Ty = Te/(1.0/3.0*1.3+2.0/3.0);		/* [K] */
 const double Tx = 1.3*Ty;						/* [K] */
 
-void save_analytical_solution()
+/* returns tau0, the temperature difference Tx - Ty relaxes like
+ * dT0*exp(-8/(5*sqrt(2*PI))*t/tau0) */
+double save_analytical_solution()
 {
 	double lambda_D = sqrt(EPS0*K*Te/(ne*QE*QE));
 	double ln_Lambda = log(lambda_D*2*PI*EPS0*3*K*Te/(QE*QE));
@@ -64,11 +66,20 @@ void save_analytical_solution()
 	}
 
 	out.close();
+
+	return tau0;
 }
 
-int main()
+/* the optional argument is the tolerance of the scattering angle table of
+ * DSMC_Nanbu, the analytic form is sampled without it, the largest and rms
+ * deviation of Tx - (Ty + Tz)/2 from the analytical solution are printed in
+ * units of dT0 */
+int main(int argc, char *argv[])
 {
-	save_analytical_solution();
+	double table_tolerance = argc > 1 ? atof(argv[1]) : 0;
+
+	double tau0 = save_analytical_solution();
+	double dT0 = Tx - Ty;
 
 	Vector3d x_min, x_max, x_mid;
 	x_min << -0.0005, -0.0005, -0.0005;
@@ -92,13 +103,14 @@ int main()
 	species[0].add_warm_box(x_min, x_max, ne, {0, 0, 0}, {Tx, Ty, Ty});
 
 	vector<unique_ptr<Interaction>> interactions;
-	interactions.push_back(make_unique<DSMC_Nanbu>(domain, species, Te, ne));
+	interactions.push_back(make_unique<DSMC_Nanbu>(domain, species, Te, ne,
+				table_tolerance));
+
+	double max_deviation = 0, sum_deviation2 = 0;
 
 	while (domain.advance_time()) {
 		for(Species &sp : species) {
-			sp.push_particles_leapfrog();
-			sp.calc_number_density();
-			sp.sample_moments();
+			sp.push_particles_and_deposit(true);
 			sp.calc_gas_properties();
 		}
 
@@ -107,10 +119,22 @@ int main()
 		for(auto &interaction : interactions)
 			interaction->apply(domain.get_time_step());
 
+		Vector3d T = species[0].get_translation_temperature();
+		double t = domain.get_iter()*domain.get_time_step();
+		double deviation = (T(X) - (T(Y) + T(Z))/2)/dT0 - exp(-8/(5*sqrt(2*PI))*t/tau0);
+		max_deviation = max(max_deviation, fabs(deviation));
+		sum_deviation2 += deviation*deviation;
+
 		if (domain.get_iter()%10 == 0 || domain.is_last_iter()) {
 			domain.print_info(species);
 			domain.write_statistics(species);
 			//domain.save_velocity_histogram(species);
 		}
 	}
+
+	for(auto &interaction : interactions)
+		interaction->print_info();
+
+	cout << "deviation from the analytical solution: max " << max_deviation
+		 << "  rms " << sqrt(sum_deviation2/domain.get_iter()) << endl;
 }
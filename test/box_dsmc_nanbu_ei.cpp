@@ -19,7 +19,9 @@ const double Tinf = (Te + Ti)/2;	/* [K] */
 const double me   = ME;				/* [kg] */
 const double mi   = 4*ME;			/* [kg] */
 
-void save_analytical_solution()
+/* returns nueq, the temperature difference Te - Ti relaxes like
+ * (Te - Ti)*exp(-2*nueq*t) */
+double save_analytical_solution()
 {
 	double lambda_D = sqrt(EPS0*K*Tinf/(n*QE*QE));
 	double ln_Lambda = log(lambda_D*2*PI*EPS0*3*K*Tinf/(QE*QE));
@@ -69,11 +71,20 @@ void save_analytical_solution()
 	}
 
 	out.close();
+
+	return nueq;
 }
 
-int main()
+/* the optional argument is the tolerance of the scattering angle table of
+ * DSMC_Nanbu, the analytic form is sampled without it, the largest and rms
+ * deviation of Te - Ti from the analytical solution are printed in units of
+ * the initial difference */
+int main(int argc, char *argv[])
 {
-	save_analytical_solution();
+	double table_tolerance = argc > 1 ? atof(argv[1]) : 0;
+
+	double nueq = save_analytical_solution();
+	double dT0 = Te - Ti;
 
 	Vector3d x_min, x_max, x_mid;
 	x_min << -0.0005, -0.0005, -0.0005;
@@ -99,13 +110,14 @@ int main()
 	species[1].add_warm_box(x_min, x_max, n, {0, 0, 0}, Ti);
 
 	vector<unique_ptr<Interaction>> interactions;
-	interactions.push_back(make_unique<DSMC_Nanbu>(domain, species, Te, n));
+	interactions.push_back(make_unique<DSMC_Nanbu>(domain, species, Te, n,
+				table_tolerance));
+
+	double max_deviation = 0, sum_deviation2 = 0;
 
 	while (domain.advance_time()) {
 		for(Species &sp : species) {
-			sp.push_particles_leapfrog();
-			sp.calc_number_density();
-			sp.sample_moments();
+			sp.push_particles_and_deposit(true);
 			sp.calc_gas_properties();
 		}
 
@@ -114,9 +126,21 @@ int main()
 		for(auto &interaction : interactions)
 			interaction->apply(domain.get_time_step());
 
+		double t = domain.get_iter()*domain.get_time_step();
+		double deviation = (species[0].get_translation_temperature().mean()
+				- species[1].get_translation_temperature().mean())/dT0 - exp(-2*nueq*t);
+		max_deviation = max(max_deviation, fabs(deviation));
+		sum_deviation2 += deviation*deviation;
+
 		if (domain.get_iter()%10 == 0 || domain.is_last_iter()) {
 			domain.print_info(species);
 			domain.write_statistics(species);
 		}
 	}
+
+	for(auto &interaction : interactions)
+		interaction->print_info();
+
+	cout << "deviation from the analytical solution: max " << max_deviation
+		 << "  rms " << sqrt(sum_deviation2/domain.get_iter()) << endl;
 }
@@ -69,10 +69,7 @@ int main()
 			source->sample();
 
 		for (Species &sp : species) {
-			sp.push_particles_leapfrog();
-			sp.remove_dead_particles();
-			sp.calc_number_density();
-			sp.sample_moments();
+			sp.push_particles_and_deposit(true);
 			sp.calc_gas_properties();
 		}
 
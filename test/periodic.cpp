@@ -51,9 +51,7 @@ int main()
 			source->sample();
 
 		for(Species &sp : species) {
-			sp.push_particles_leapfrog();
-			sp.remove_dead_particles();
-			sp.calc_number_density();
+			sp.push_particles_and_deposit();
 		}
 
 		domain.calc_charge_density(species);
@@ -103,9 +103,7 @@ int main()
 			source->sample();
 
 		for(Species &sp : species) {
-			sp.push_particles_leapfrog();
-			sp.remove_dead_particles();
-			sp.calc_number_density();
+			sp.push_particles_and_deposit();
 		}
 
 		if (!domain.averaing_time() && domain.steady_state(species, 50, 0.01)) {